@@ -4,6 +4,8 @@
 
 #include "bench.h"
 
+#include "crypto/neoscrypt.h"
+#include "crypto/scrypt.h"
 #include "crypto/sha256.h"
 #include "key.h"
 #include "validation.h"
@@ -14,10 +16,13 @@ int
 main(int argc, char** argv)
 {
     SHA256AutoDetect();
+    scrypt_batch_autodetect();
+    neoscrypt_batch_autodetect();
     RandomInit();
     ECC_Start();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
+    InitPoWCache();
 
     benchmark::BenchRunner::RunAll();
 
@@ -0,0 +1,115 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "checkqueue.h"
+#include "primitives/block.h"
+#include "util.h"
+
+#include <vector>
+#include <boost/thread/thread.hpp>
+
+// Block versions that select each proof of work algorithm in GetPoWHash()
+static const int32_t SCRYPT_VERSION = 4;
+static const int32_t NEOSCRYPT_VERSION = 1610612736;
+static const int32_t YESCRYPT_VERSION = 1879048192;
+
+// Headers hashed per iteration by the batch and multi-threaded benchmarks
+static const size_t BATCH_SIZE = 16;
+static const int MIN_CORES = 2;
+
+static std::vector<CBlockHeader> CreateHeaders(int32_t nVersion, size_t count)
+{
+    std::vector<CBlockHeader> headers(count);
+    for (size_t i = 0; i < count; i++) {
+        headers[i].nVersion = nVersion;
+        headers[i].nTime = 1500000000;
+        headers[i].nBits = 0x1e0ffff0;
+        headers[i].nNonce = i;
+    }
+    return headers;
+}
+
+// Latency of one PoW hash
+static void PoWHash(benchmark::State& state, int32_t nVersion)
+{
+    CBlockHeader header = CreateHeaders(nVersion, 1)[0];
+    while (state.KeepRunning()) {
+        header.GetPoWHash();
+        header.nNonce++;
+    }
+}
+
+// Throughput of GetPoWHashes(), which uses the multi-buffer kernels
+static void PoWHashBatch(benchmark::State& state, int32_t nVersion)
+{
+    std::vector<CBlockHeader> headers = CreateHeaders(nVersion, BATCH_SIZE);
+    std::vector<const CBlockHeader*> pheaders;
+    for (const CBlockHeader& header : headers) {
+        pheaders.push_back(&header);
+    }
+    while (state.KeepRunning()) {
+        GetPoWHashes(pheaders);
+        for (CBlockHeader& header : headers) {
+            header.nNonce += BATCH_SIZE;
+        }
+    }
+}
+
+// Scaling of one-header checks over a check queue, as in header sync
+static void PoWHashThreads(benchmark::State& state, int32_t nVersion)
+{
+    struct PoWJob {
+        const CBlockHeader* pheader;
+        PoWJob() : pheader(nullptr) {}
+        explicit PoWJob(const CBlockHeader& header) : pheader(&header) {}
+        bool operator()()
+        {
+            pheader->GetPoWHash();
+            return true;
+        }
+        void swap(PoWJob& x) { std::swap(pheader, x.pheader); }
+    };
+    const int nThreads = std::max(MIN_CORES, GetNumCores());
+    std::vector<CBlockHeader> headers = CreateHeaders(nVersion, BATCH_SIZE);
+    CCheckQueue<PoWJob> queue {1};
+    boost::thread_group tg;
+    for (int x = 0; x < nThreads - 1; ++x) {
+        tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<PoWJob> control(&queue);
+        std::vector<PoWJob> vChecks;
+        for (const CBlockHeader& header : headers) {
+            vChecks.emplace_back(header);
+        }
+        control.Add(vChecks);
+        control.Wait();
+        for (CBlockHeader& header : headers) {
+            header.nNonce += BATCH_SIZE;
+        }
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+static void PoWHashScrypt(benchmark::State& state) { PoWHash(state, SCRYPT_VERSION); }
+static void PoWHashNeoscrypt(benchmark::State& state) { PoWHash(state, NEOSCRYPT_VERSION); }
+static void PoWHashYescrypt(benchmark::State& state) { PoWHash(state, YESCRYPT_VERSION); }
+static void PoWHashBatchScrypt(benchmark::State& state) { PoWHashBatch(state, SCRYPT_VERSION); }
+static void PoWHashBatchNeoscrypt(benchmark::State& state) { PoWHashBatch(state, NEOSCRYPT_VERSION); }
+static void PoWHashBatchYescrypt(benchmark::State& state) { PoWHashBatch(state, YESCRYPT_VERSION); }
+static void PoWHashThreadsScrypt(benchmark::State& state) { PoWHashThreads(state, SCRYPT_VERSION); }
+static void PoWHashThreadsNeoscrypt(benchmark::State& state) { PoWHashThreads(state, NEOSCRYPT_VERSION); }
+static void PoWHashThreadsYescrypt(benchmark::State& state) { PoWHashThreads(state, YESCRYPT_VERSION); }
+
+BENCHMARK(PoWHashScrypt);
+BENCHMARK(PoWHashNeoscrypt);
+BENCHMARK(PoWHashYescrypt);
+BENCHMARK(PoWHashBatchScrypt);
+BENCHMARK(PoWHashBatchNeoscrypt);
+BENCHMARK(PoWHashBatchYescrypt);
+BENCHMARK(PoWHashThreadsScrypt);
+BENCHMARK(PoWHashThreadsNeoscrypt);
+BENCHMARK(PoWHashThreadsYescrypt);
@@ -0,0 +1,61 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "pow.h"
+#include "random.h"
+
+#include <vector>
+
+static const int CHAIN_LENGTH = 100000;
+// Blocks retargeted per iteration of GetNextWorkRequiredChain
+static const int RETARGET_COUNT = 1000;
+
+// A synthetic main chain with jittered block times, long enough to reach the
+// DarkGravityWave v3 era of GetNextWorkRequired() (height 95532)
+static std::vector<CBlockIndex> CreateChain(const Consensus::Params& params)
+{
+    FastRandomContext rand(true);
+    std::vector<CBlockIndex> blocks(CHAIN_LENGTH);
+    for (int i = 0; i < CHAIN_LENGTH; i++) {
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].nHeight = i;
+        blocks[i].nTime = i ? blocks[i - 1].nTime + params.nPowTargetSpacing / 2 + rand.randrange(params.nPowTargetSpacing) : 1500000000;
+        blocks[i].nBits = 0x1c0fffff + rand.randrange(0xffff);
+    }
+    return blocks;
+}
+
+// One retarget at the tip, which is DarkGravityWave v3
+static void GetNextWorkRequiredTip(benchmark::State& state)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = chainParams->GetConsensus();
+    std::vector<CBlockIndex> blocks = CreateChain(params);
+    CBlockHeader header;
+    header.nTime = blocks.back().nTime + params.nPowTargetSpacing;
+    while (state.KeepRunning()) {
+        GetNextWorkRequired(&blocks.back(), &header, params);
+    }
+}
+
+// A retarget for each of the last blocks of the chain, as done when connecting them
+static void GetNextWorkRequiredChain(benchmark::State& state)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = chainParams->GetConsensus();
+    std::vector<CBlockIndex> blocks = CreateChain(params);
+    CBlockHeader header;
+    while (state.KeepRunning()) {
+        for (int i = CHAIN_LENGTH - RETARGET_COUNT - 1; i < CHAIN_LENGTH - 1; i++) {
+            header.nTime = blocks[i + 1].nTime;
+            GetNextWorkRequired(&blocks[i], &header, params);
+        }
+    }
+}
+
+BENCHMARK(GetNextWorkRequiredTip);
+BENCHMARK(GetNextWorkRequiredChain);
@@ -12,6 +12,7 @@
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "uint256.h"
 
 #include <assert.h>
@@ -85,7 +86,7 @@ class SaltedOutpointHasher
 {
 private:
     /** Salt */
-    const uint64_t k0, k1;
+    uint64_t k0, k1;
 
 public:
     SaltedOutpointHasher();
@@ -119,7 +120,14 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The nodes of a CCoinsMap come from a pool owned by the map's allocator
+ * rather than from one malloc each. The block size leaves room for the
+ * implementation-defined node overhead (next pointer, cached hash) on top of
+ * the entry itself.
+ */
+typedef PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>, sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + 4 * sizeof(void*)> CCoinsMapAllocator;
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>, CCoinsMapAllocator> CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -151,6 +159,14 @@ public:
      */
     virtual bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
 
+    /** Retrieve the coins for several outpoints at once. found[i] is set when an
+     *  unspent coin was found for outpoints[i], which is returned in coins[i].
+     *  Views that can look up many coins faster than one at a time override
+     *  this; the default calls GetCoin for each outpoint.
+     *  Returns the number of coins found.
+     */
+    virtual size_t GetCoins(const std::vector<COutPoint> &outpoints, std::vector<Coin> &coins, std::vector<bool> &found) const;
+
     //! Just check whether a given outpoint is unspent.
     virtual bool HaveCoin(const COutPoint &outpoint) const;
 
@@ -186,6 +202,8 @@ protected:
 
 public:
     CCoinsViewBacked(CCoinsView *viewIn);
+    // GetCoins is deliberately not forwarded, so that views overriding
+    // GetCoin (like CCoinsViewMemPool) still see every lookup.
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
@@ -231,6 +249,23 @@ public:
      */
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
+    /**
+     * Read a coin from the backing view without looking at or filling the
+     * cache. As the cache is not touched, this may be called from several
+     * threads at once, as long as nothing modifies the backing view meanwhile.
+     */
+    bool GetCoinFromBase(const COutPoint &outpoint, Coin &coin) const;
+
+    //! Like GetCoinFromBase(), for several outpoints at once (see CCoinsView::GetCoins).
+    size_t GetCoinsFromBase(const std::vector<COutPoint> &outpoints, std::vector<Coin> &coins, std::vector<bool> &found) const;
+
+    /**
+     * Add a coin read with GetCoin(s)FromBase() to the cache, the same way a cache
+     * miss in GetCoin() would have. Has no effect if the cache already has an
+     * entry for the outpoint.
+     */
+    void AddFetchedCoin(const COutPoint &outpoint, Coin&& coin);
+
     /**
      * Return a reference to Coin in the cache, or a pruned one if not found. This is
      * more efficient than GetCoin.
@@ -0,0 +1,125 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// Multi-buffer NeoScrypt(128, 2, 1) core: 8 independent hashes are computed
+// at once, with word k of every hash kept in lane 0..7 of one AVX2 register.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace
+{
+
+inline __m256i Rotl(__m256i x, int n) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+
+inline void SalsaQuarter(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    b = _mm256_xor_si256(b, Rotl(_mm256_add_epi32(a, d), 7));
+    c = _mm256_xor_si256(c, Rotl(_mm256_add_epi32(b, a), 9));
+    d = _mm256_xor_si256(d, Rotl(_mm256_add_epi32(c, b), 13));
+    a = _mm256_xor_si256(a, Rotl(_mm256_add_epi32(d, c), 18));
+}
+
+inline void ChaChaQuarter(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    a = _mm256_add_epi32(a, b); d = Rotl(_mm256_xor_si256(d, a), 16);
+    c = _mm256_add_epi32(c, d); b = Rotl(_mm256_xor_si256(b, c), 12);
+    a = _mm256_add_epi32(a, b); d = Rotl(_mm256_xor_si256(d, a), 8);
+    c = _mm256_add_epi32(c, d); b = Rotl(_mm256_xor_si256(b, c), 7);
+}
+
+/** Salsa20/20 or ChaCha20/20 of one 64 byte block of every lane. */
+template<bool chacha>
+inline void Mix(__m256i B[16])
+{
+    __m256i x[16];
+    for (int k = 0; k < 16; k++) {
+        x[k] = B[k];
+    }
+    for (int i = 0; i < 20; i += 2) {
+        if (chacha) {
+            ChaChaQuarter(x[0], x[4], x[8], x[12]);
+            ChaChaQuarter(x[1], x[5], x[9], x[13]);
+            ChaChaQuarter(x[2], x[6], x[10], x[14]);
+            ChaChaQuarter(x[3], x[7], x[11], x[15]);
+            ChaChaQuarter(x[0], x[5], x[10], x[15]);
+            ChaChaQuarter(x[1], x[6], x[11], x[12]);
+            ChaChaQuarter(x[2], x[7], x[8], x[13]);
+            ChaChaQuarter(x[3], x[4], x[9], x[14]);
+        } else {
+            SalsaQuarter(x[0], x[4], x[8], x[12]);
+            SalsaQuarter(x[5], x[9], x[13], x[1]);
+            SalsaQuarter(x[10], x[14], x[2], x[6]);
+            SalsaQuarter(x[15], x[3], x[7], x[11]);
+            SalsaQuarter(x[0], x[1], x[2], x[3]);
+            SalsaQuarter(x[5], x[6], x[7], x[4]);
+            SalsaQuarter(x[10], x[11], x[8], x[9]);
+            SalsaQuarter(x[15], x[12], x[13], x[14]);
+        }
+    }
+    for (int k = 0; k < 16; k++) {
+        B[k] = _mm256_add_epi32(B[k], x[k]);
+    }
+}
+
+/** neoscrypt_blkmix() with r = 2. */
+template<bool chacha>
+inline void BlkMix(__m256i X[64])
+{
+    for (int b = 0; b < 4; b++) {
+        const __m256i* prev = &X[16 * ((b + 3) & 3)];
+        for (int k = 0; k < 16; k++) {
+            X[16 * b + k] = _mm256_xor_si256(X[16 * b + k], prev[k]);
+        }
+        Mix<chacha>(&X[16 * b]);
+    }
+    for (int k = 0; k < 16; k++) {
+        __m256i t = X[16 + k];
+        X[16 + k] = X[32 + k];
+        X[32 + k] = t;
+    }
+}
+
+template<bool chacha>
+void SMix(__m256i X[64], uint32_t* V)
+{
+    __m256i* v = (__m256i*)V;
+    for (int i = 0; i < 128; i++) {
+        for (int k = 0; k < 64; k++) {
+            _mm256_store_si256(v + i * 64 + k, X[k]);
+        }
+        BlkMix<chacha>(X);
+    }
+
+    // Each lane reads its own row of V, so the lookups are gathers.
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i mask = _mm256_set1_epi32(127);
+    for (int i = 0; i < 128; i++) {
+        const __m256i idx = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(X[48], mask), 9), lane);
+        for (int k = 0; k < 64; k++) {
+            X[k] = _mm256_xor_si256(X[k], _mm256_i32gather_epi32((const int*)(V + k * 8), idx, 4));
+        }
+        BlkMix<chacha>(X);
+    }
+}
+
+} // namespace
+
+/** X holds 64 words of 8 lanes each (word-major), V is a 32 byte aligned scratchpad of 128 * 64 * 8 words. */
+extern "C" void neoscrypt_core_8way(unsigned int* X, unsigned int* V)
+{
+    __m256i x[64], z[64];
+    for (int k = 0; k < 64; k++) {
+        x[k] = z[k] = _mm256_loadu_si256((const __m256i*)(X + k * 8));
+    }
+    SMix<true>(z, V);
+    SMix<false>(x, V);
+    for (int k = 0; k < 64; k++) {
+        _mm256_storeu_si256((__m256i*)(X + k * 8), _mm256_xor_si256(x[k], z[k]));
+    }
+}
+
+#endif
@@ -0,0 +1,128 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// Multi-buffer NeoScrypt(128, 2, 1) core: 4 independent hashes are computed
+// at once, with word k of every hash kept in lane 0..3 of one SSE register.
+
+#ifdef ENABLE_SSE41
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace
+{
+
+inline __m128i Rotl(__m128i x, int n) { return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n)); }
+
+inline void SalsaQuarter(__m128i& a, __m128i& b, __m128i& c, __m128i& d)
+{
+    b = _mm_xor_si128(b, Rotl(_mm_add_epi32(a, d), 7));
+    c = _mm_xor_si128(c, Rotl(_mm_add_epi32(b, a), 9));
+    d = _mm_xor_si128(d, Rotl(_mm_add_epi32(c, b), 13));
+    a = _mm_xor_si128(a, Rotl(_mm_add_epi32(d, c), 18));
+}
+
+inline void ChaChaQuarter(__m128i& a, __m128i& b, __m128i& c, __m128i& d)
+{
+    a = _mm_add_epi32(a, b); d = Rotl(_mm_xor_si128(d, a), 16);
+    c = _mm_add_epi32(c, d); b = Rotl(_mm_xor_si128(b, c), 12);
+    a = _mm_add_epi32(a, b); d = Rotl(_mm_xor_si128(d, a), 8);
+    c = _mm_add_epi32(c, d); b = Rotl(_mm_xor_si128(b, c), 7);
+}
+
+/** Salsa20/20 or ChaCha20/20 of one 64 byte block of every lane. */
+template<bool chacha>
+inline void Mix(__m128i B[16])
+{
+    __m128i x[16];
+    for (int k = 0; k < 16; k++) {
+        x[k] = B[k];
+    }
+    for (int i = 0; i < 20; i += 2) {
+        if (chacha) {
+            ChaChaQuarter(x[0], x[4], x[8], x[12]);
+            ChaChaQuarter(x[1], x[5], x[9], x[13]);
+            ChaChaQuarter(x[2], x[6], x[10], x[14]);
+            ChaChaQuarter(x[3], x[7], x[11], x[15]);
+            ChaChaQuarter(x[0], x[5], x[10], x[15]);
+            ChaChaQuarter(x[1], x[6], x[11], x[12]);
+            ChaChaQuarter(x[2], x[7], x[8], x[13]);
+            ChaChaQuarter(x[3], x[4], x[9], x[14]);
+        } else {
+            SalsaQuarter(x[0], x[4], x[8], x[12]);
+            SalsaQuarter(x[5], x[9], x[13], x[1]);
+            SalsaQuarter(x[10], x[14], x[2], x[6]);
+            SalsaQuarter(x[15], x[3], x[7], x[11]);
+            SalsaQuarter(x[0], x[1], x[2], x[3]);
+            SalsaQuarter(x[5], x[6], x[7], x[4]);
+            SalsaQuarter(x[10], x[11], x[8], x[9]);
+            SalsaQuarter(x[15], x[12], x[13], x[14]);
+        }
+    }
+    for (int k = 0; k < 16; k++) {
+        B[k] = _mm_add_epi32(B[k], x[k]);
+    }
+}
+
+/** neoscrypt_blkmix() with r = 2. */
+template<bool chacha>
+inline void BlkMix(__m128i X[64])
+{
+    for (int b = 0; b < 4; b++) {
+        const __m128i* prev = &X[16 * ((b + 3) & 3)];
+        for (int k = 0; k < 16; k++) {
+            X[16 * b + k] = _mm_xor_si128(X[16 * b + k], prev[k]);
+        }
+        Mix<chacha>(&X[16 * b]);
+    }
+    for (int k = 0; k < 16; k++) {
+        __m128i t = X[16 + k];
+        X[16 + k] = X[32 + k];
+        X[32 + k] = t;
+    }
+}
+
+template<bool chacha>
+void SMix(__m128i X[64], uint32_t* V)
+{
+    __m128i* v = (__m128i*)V;
+    for (int i = 0; i < 128; i++) {
+        for (int k = 0; k < 64; k++) {
+            _mm_store_si128(v + i * 64 + k, X[k]);
+        }
+        BlkMix<chacha>(X);
+    }
+
+    // Each lane reads its own row of V; there is no gather before AVX2, so
+    // the four row offsets are extracted and the words loaded one by one.
+    for (int i = 0; i < 128; i++) {
+        const uint32_t j0 = ((_mm_extract_epi32(X[48], 0) & 127) << 8) + 0;
+        const uint32_t j1 = ((_mm_extract_epi32(X[48], 1) & 127) << 8) + 1;
+        const uint32_t j2 = ((_mm_extract_epi32(X[48], 2) & 127) << 8) + 2;
+        const uint32_t j3 = ((_mm_extract_epi32(X[48], 3) & 127) << 8) + 3;
+        for (int k = 0; k < 64; k++) {
+            const uint32_t* row = V + k * 4;
+            X[k] = _mm_xor_si128(X[k], _mm_setr_epi32(row[j0], row[j1], row[j2], row[j3]));
+        }
+        BlkMix<chacha>(X);
+    }
+}
+
+} // namespace
+
+/** X holds 64 words of 4 lanes each (word-major), V is a 16 byte aligned scratchpad of 128 * 64 * 4 words. */
+extern "C" void neoscrypt_core_4way(unsigned int* X, unsigned int* V)
+{
+    __m128i x[64], z[64];
+    for (int k = 0; k < 64; k++) {
+        x[k] = z[k] = _mm_loadu_si128((const __m128i*)(X + k * 4));
+    }
+    SMix<true>(z, V);
+    SMix<false>(x, V);
+    for (int k = 0; k < 64; k++) {
+        _mm_storeu_si128((__m128i*)(X + k * 4), _mm_xor_si128(x[k], z[k]));
+    }
+}
+
+#endif
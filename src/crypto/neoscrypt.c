@@ -2398,3 +2398,139 @@ void neoscrypt(const unsigned char *password, unsigned char *output, unsigned in
 }
 
 #endif /* !(USE_ASM) */
+
+
+/* Multi-buffer NeoScrypt: the profile 0 core of several hashes at once */
+
+#if defined(ENABLE_SSE41) || defined(ENABLE_AVX2)
+#include <cpuid.h>
+#endif
+
+/* X holds 64 words of lanes hashes each (word-major), V is a scratchpad
+ * of 128 * 64 * lanes words aligned to 64 bytes */
+typedef void (*neoscrypt_core_batch_t)(unsigned int *X, unsigned int *V);
+
+#if defined(ENABLE_SSE41)
+extern void neoscrypt_core_4way(unsigned int *X, unsigned int *V);
+#endif
+#if defined(ENABLE_AVX2)
+extern void neoscrypt_core_8way(unsigned int *X, unsigned int *V);
+#endif
+
+static neoscrypt_core_batch_t neoscrypt_core_batch = NULL;
+static unsigned int neoscrypt_core_batch_lanes = 1;
+
+/* FastKDF of profile 0: mode 0 derives X from the password,
+ * mode 1 derives the output from the password and X */
+static void neoscrypt_batch_kdf(const unsigned char *password, const unsigned char *salt,
+  unsigned char *output, unsigned int mode) {
+#ifdef OPT
+    neoscrypt_fastkdf_opt(password, salt, output, mode);
+#else
+    if(!mode)
+      neoscrypt_fastkdf(password, 80, salt, 80, 32, output, 256);
+    else
+      neoscrypt_fastkdf(password, 80, salt, 256, 32, output, 32);
+#endif
+}
+
+static void neoscrypt_batch_kernel(neoscrypt_core_batch_t core, unsigned int lanes,
+  const unsigned char * const *passwords, unsigned char * const *outputs, unsigned int count) {
+    unsigned int B[64];
+    unsigned int *X, *V;
+    unsigned char *scratchpad;
+    unsigned int n, l, k;
+
+    scratchpad = (unsigned char *) malloc((128 + 1) * 256 * lanes + 63);
+    if(!scratchpad)
+      abort();
+    V = (unsigned int *) (((size_t)scratchpad + 63) & ~(size_t)63);
+    X = &V[128 * 64 * lanes];
+
+    for(n = 0; n < count; n += lanes) {
+        for(l = 0; l < lanes; l++) {
+            neoscrypt_batch_kdf(passwords[n + l], passwords[n + l], (unsigned char *) B, 0);
+            for(k = 0; k < 64; k++)
+              X[k * lanes + l] = B[k];
+        }
+        core(X, V);
+        for(l = 0; l < lanes; l++) {
+            for(k = 0; k < 64; k++)
+              B[k] = X[k * lanes + l];
+            neoscrypt_batch_kdf(passwords[n + l], (unsigned char *) B, outputs[n + l], 1);
+        }
+    }
+
+    free(scratchpad);
+}
+
+void neoscrypt_batch(const unsigned char * const *passwords, unsigned char * const *outputs,
+  unsigned int count) {
+    unsigned int n = 0;
+
+    if(neoscrypt_core_batch && (count >= neoscrypt_core_batch_lanes)) {
+        n = count - count % neoscrypt_core_batch_lanes;
+        neoscrypt_batch_kernel(neoscrypt_core_batch, neoscrypt_core_batch_lanes, passwords, outputs, n);
+    }
+    for(; n < count; n++)
+      neoscrypt(passwords[n], outputs[n], 0x0);
+}
+
+unsigned int neoscrypt_batch_lanes(void) {
+    return(neoscrypt_core_batch_lanes);
+}
+
+#if defined(ENABLE_SSE41) || defined(ENABLE_AVX2)
+/* Check that a multi-buffer core agrees with neoscrypt() on every lane */
+static int neoscrypt_batch_selftest(neoscrypt_core_batch_t core, unsigned int lanes) {
+    unsigned char input[8][80], output[8][32], expected[32];
+    const unsigned char *inputs[8];
+    unsigned char *outputs[8];
+    unsigned int i, l;
+
+    for(l = 0; l < lanes; l++) {
+        for(i = 0; i < 80; i++)
+          input[l][i] = (unsigned char)(i * 7 + l);
+        inputs[l] = input[l];
+        outputs[l] = output[l];
+    }
+    neoscrypt_batch_kernel(core, lanes, inputs, outputs, lanes);
+    for(l = 0; l < lanes; l++) {
+        neoscrypt(input[l], expected, 0x0);
+        if(memcmp(output[l], expected, 32))
+          return(0);
+    }
+    return(1);
+}
+#endif
+
+const char *neoscrypt_batch_autodetect(void) {
+#if defined(ENABLE_SSE41) || defined(ENABLE_AVX2)
+    unsigned int eax, ebx, ecx, edx;
+
+    if(__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+#if defined(ENABLE_AVX2)
+        /* AVX2 needs OSXSAVE and the OS saving the XMM and YMM state */
+        unsigned int eax7, ebx7, ecx7, edx7, xcr0_lo, xcr0_hi;
+        if(((ecx >> 27) & 1) && __get_cpuid_count(7, 0, &eax7, &ebx7, &ecx7, &edx7) && ((ebx7 >> 5) & 1)) {
+            __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+            if(((xcr0_lo & 0x6) == 0x6) && neoscrypt_batch_selftest(neoscrypt_core_8way, 8)) {
+                neoscrypt_core_batch = neoscrypt_core_8way;
+                neoscrypt_core_batch_lanes = 8;
+                return("avx2 (8-way)");
+            }
+        }
+#endif
+#if defined(ENABLE_SSE41)
+        if(((ecx >> 19) & 1) && neoscrypt_batch_selftest(neoscrypt_core_4way, 4)) {
+            neoscrypt_core_batch = neoscrypt_core_4way;
+            neoscrypt_core_batch_lanes = 4;
+            return("sse4.1 (4-way)");
+        }
+#endif
+    }
+#endif
+    neoscrypt_core_batch = NULL;
+    neoscrypt_core_batch_lanes = 1;
+    return("standard");
+}
@@ -9,6 +9,18 @@ extern "C" {
 void neoscrypt(const unsigned char *password, unsigned char *output,
   unsigned int profile);
 
+/* Hash count independent 80-byte passwords with profile 0, using the
+ * multi-buffer core selected by neoscrypt_batch_autodetect() for as many
+ * of them as possible */
+void neoscrypt_batch(const unsigned char * const *passwords, unsigned char * const *outputs,
+  unsigned int count);
+
+/* Autodetect the best available multi-buffer core; returns its name */
+const char *neoscrypt_batch_autodetect(void);
+
+/* Number of hashes the selected multi-buffer core computes at once (1 if none) */
+unsigned int neoscrypt_batch_lanes(void);
+
 void neoscrypt_blake2s(const void *input, const unsigned int input_size,
   const void *key, const unsigned char key_size,
   void *output, const unsigned char output_size);
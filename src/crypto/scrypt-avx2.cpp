@@ -0,0 +1,89 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// Multi-buffer scrypt(1024,1,1) core: 8 independent hashes are computed at
+// once, with word k of every hash kept in lane 0..7 of one AVX2 register.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace scrypt_avx2
+{
+namespace
+{
+
+inline __m256i Rotl(__m256i x, int n) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+
+inline void QuarterRound(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    b = _mm256_xor_si256(b, Rotl(_mm256_add_epi32(a, d), 7));
+    c = _mm256_xor_si256(c, Rotl(_mm256_add_epi32(b, a), 9));
+    d = _mm256_xor_si256(d, Rotl(_mm256_add_epi32(c, b), 13));
+    a = _mm256_xor_si256(a, Rotl(_mm256_add_epi32(d, c), 18));
+}
+
+inline void XorSalsa8(__m256i B[16], const __m256i Bx[16])
+{
+    __m256i x[16];
+    for (int k = 0; k < 16; k++) {
+        x[k] = B[k] = _mm256_xor_si256(B[k], Bx[k]);
+    }
+    for (int i = 0; i < 8; i += 2) {
+        /* Operate on columns. */
+        QuarterRound(x[0], x[4], x[8], x[12]);
+        QuarterRound(x[5], x[9], x[13], x[1]);
+        QuarterRound(x[10], x[14], x[2], x[6]);
+        QuarterRound(x[15], x[3], x[7], x[11]);
+        /* Operate on rows. */
+        QuarterRound(x[0], x[1], x[2], x[3]);
+        QuarterRound(x[5], x[6], x[7], x[4]);
+        QuarterRound(x[10], x[11], x[8], x[9]);
+        QuarterRound(x[15], x[12], x[13], x[14]);
+    }
+    for (int k = 0; k < 16; k++) {
+        B[k] = _mm256_add_epi32(B[k], x[k]);
+    }
+}
+
+} // namespace
+
+/** X holds 32 words of 8 lanes each (word-major), V is a 32 byte aligned scratchpad of 1024 * 32 * 8 words. */
+void ROMix_8way(uint32_t* X, uint32_t* V)
+{
+    __m256i x[32];
+    __m256i* v = (__m256i*)V;
+    for (int k = 0; k < 32; k++) {
+        x[k] = _mm256_loadu_si256((const __m256i*)(X + k * 8));
+    }
+
+    for (int i = 0; i < 1024; i++) {
+        for (int k = 0; k < 32; k++) {
+            _mm256_store_si256(v + i * 32 + k, x[k]);
+        }
+        XorSalsa8(&x[0], &x[16]);
+        XorSalsa8(&x[16], &x[0]);
+    }
+
+    // Each lane reads its own row of V, so the lookups are gathers.
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i mask = _mm256_set1_epi32(1023);
+    for (int i = 0; i < 1024; i++) {
+        const __m256i idx = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(x[16], mask), 8), lane);
+        for (int k = 0; k < 32; k++) {
+            x[k] = _mm256_xor_si256(x[k], _mm256_i32gather_epi32((const int*)(V + k * 8), idx, 4));
+        }
+        XorSalsa8(&x[0], &x[16]);
+        XorSalsa8(&x[16], &x[0]);
+    }
+
+    for (int k = 0; k < 32; k++) {
+        _mm256_storeu_si256((__m256i*)(X + k * 8), x[k]);
+    }
+}
+
+} // namespace scrypt_avx2
+
+#endif
@@ -0,0 +1,87 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// Multi-buffer scrypt(1024,1,1) core: 16 independent hashes are computed at
+// once, with word k of every hash kept in lane 0..15 of one AVX-512 register.
+
+#ifdef ENABLE_AVX512F
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace scrypt_avx512
+{
+namespace
+{
+
+inline void QuarterRound(__m512i& a, __m512i& b, __m512i& c, __m512i& d)
+{
+    b = _mm512_xor_si512(b, _mm512_rol_epi32(_mm512_add_epi32(a, d), 7));
+    c = _mm512_xor_si512(c, _mm512_rol_epi32(_mm512_add_epi32(b, a), 9));
+    d = _mm512_xor_si512(d, _mm512_rol_epi32(_mm512_add_epi32(c, b), 13));
+    a = _mm512_xor_si512(a, _mm512_rol_epi32(_mm512_add_epi32(d, c), 18));
+}
+
+inline void XorSalsa8(__m512i B[16], const __m512i Bx[16])
+{
+    __m512i x[16];
+    for (int k = 0; k < 16; k++) {
+        x[k] = B[k] = _mm512_xor_si512(B[k], Bx[k]);
+    }
+    for (int i = 0; i < 8; i += 2) {
+        /* Operate on columns. */
+        QuarterRound(x[0], x[4], x[8], x[12]);
+        QuarterRound(x[5], x[9], x[13], x[1]);
+        QuarterRound(x[10], x[14], x[2], x[6]);
+        QuarterRound(x[15], x[3], x[7], x[11]);
+        /* Operate on rows. */
+        QuarterRound(x[0], x[1], x[2], x[3]);
+        QuarterRound(x[5], x[6], x[7], x[4]);
+        QuarterRound(x[10], x[11], x[8], x[9]);
+        QuarterRound(x[15], x[12], x[13], x[14]);
+    }
+    for (int k = 0; k < 16; k++) {
+        B[k] = _mm512_add_epi32(B[k], x[k]);
+    }
+}
+
+} // namespace
+
+/** X holds 32 words of 16 lanes each (word-major), V is a 64 byte aligned scratchpad of 1024 * 32 * 16 words. */
+void ROMix_16way(uint32_t* X, uint32_t* V)
+{
+    __m512i x[32];
+    __m512i* v = (__m512i*)V;
+    for (int k = 0; k < 32; k++) {
+        x[k] = _mm512_loadu_si512((const void*)(X + k * 16));
+    }
+
+    for (int i = 0; i < 1024; i++) {
+        for (int k = 0; k < 32; k++) {
+            _mm512_store_si512((void*)(v + i * 32 + k), x[k]);
+        }
+        XorSalsa8(&x[0], &x[16]);
+        XorSalsa8(&x[16], &x[0]);
+    }
+
+    // Each lane reads its own row of V, so the lookups are gathers.
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i mask = _mm512_set1_epi32(1023);
+    for (int i = 0; i < 1024; i++) {
+        const __m512i idx = _mm512_add_epi32(_mm512_slli_epi32(_mm512_and_si512(x[16], mask), 9), lane);
+        for (int k = 0; k < 32; k++) {
+            x[k] = _mm512_xor_si512(x[k], _mm512_i32gather_epi32(idx, (const void*)(V + k * 16), 4));
+        }
+        XorSalsa8(&x[0], &x[16]);
+        XorSalsa8(&x[16], &x[0]);
+    }
+
+    for (int k = 0; k < 32; k++) {
+        _mm512_storeu_si512((void*)(X + k * 16), x[k]);
+    }
+}
+
+} // namespace scrypt_avx512
+
+#endif
@@ -43,6 +43,22 @@
 #include <cpuid.h>
 #endif
 #endif
+
+#if defined(ENABLE_AVX2) || defined(ENABLE_AVX512F)
+#include <cpuid.h>
+#endif
+#if defined(ENABLE_AVX2)
+namespace scrypt_avx2
+{
+void ROMix_8way(uint32_t* X, uint32_t* V);
+}
+#endif
+#if defined(ENABLE_AVX512F)
+namespace scrypt_avx512
+{
+void ROMix_16way(uint32_t* X, uint32_t* V);
+}
+#endif
 #ifndef __FreeBSD__
 static inline uint32_t be32dec(const void *pp)
 {
@@ -330,3 +346,124 @@ void scrypt_1024_1_1_256(const char *input, char *output)
 	char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
     scrypt_1024_1_1_256_sp(input, output, scratchpad);
 }
+
+/* Multi-buffer ROMix: X holds 32 words of lanes hashes each (word-major), V is
+ * a scratchpad of 1024 * 32 * lanes words aligned to 64 bytes. */
+typedef void (*ROMixBatchType)(uint32_t *X, uint32_t *V);
+
+static ROMixBatchType ROMix_batch = NULL;
+static size_t ROMix_batch_lanes = 1;
+
+static void scrypt_1024_1_1_256_batch_kernel(ROMixBatchType romix, size_t lanes,
+    const char* const *inputs, char* const *outputs, size_t count)
+{
+	uint8_t B[128];
+	uint32_t *X, *V;
+	size_t n, l, k;
+	char *scratchpad;
+
+	scratchpad = (char *)malloc((1024 + 1) * 32 * 4 * lanes + 63);
+	if (scratchpad == NULL)
+		abort();
+	V = (uint32_t *)(((uintptr_t)(scratchpad) + 63) & ~ (uintptr_t)(63));
+	X = V + 1024 * 32 * lanes;
+
+	for (n = 0; n < count; n += lanes) {
+		for (l = 0; l < lanes; l++) {
+			PBKDF2_SHA256((const uint8_t *)inputs[n + l], 80, (const uint8_t *)inputs[n + l], 80, 1, B, 128);
+			for (k = 0; k < 32; k++)
+				X[k * lanes + l] = le32dec(&B[4 * k]);
+		}
+		romix(X, V);
+		for (l = 0; l < lanes; l++) {
+			for (k = 0; k < 32; k++)
+				le32enc(&B[4 * k], X[k * lanes + l]);
+			PBKDF2_SHA256((const uint8_t *)inputs[n + l], 80, B, 128, 1, (uint8_t *)outputs[n + l], 32);
+		}
+	}
+
+	free(scratchpad);
+}
+
+void scrypt_1024_1_1_256_batch(const char* const *inputs, char* const *outputs, size_t count)
+{
+	char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
+	size_t n = 0;
+
+	if (ROMix_batch != NULL && count >= ROMix_batch_lanes) {
+		n = count - count % ROMix_batch_lanes;
+		scrypt_1024_1_1_256_batch_kernel(ROMix_batch, ROMix_batch_lanes, inputs, outputs, n);
+	}
+	for (; n < count; n++)
+		scrypt_1024_1_1_256_sp(inputs[n], outputs[n], scratchpad);
+}
+
+size_t scrypt_batch_lanes()
+{
+	return ROMix_batch_lanes;
+}
+
+#if defined(ENABLE_AVX2) || defined(ENABLE_AVX512F)
+/* Check that a multi-buffer kernel agrees with the generic implementation on every lane. */
+static bool scrypt_batch_selftest(ROMixBatchType romix, size_t lanes)
+{
+	char input[16][80];
+	char output[16][32];
+	char expected[32];
+	const char *inputs[16];
+	char *outputs[16];
+	char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
+	size_t l;
+
+	for (l = 0; l < lanes; l++) {
+		for (int i = 0; i < 80; i++)
+			input[l][i] = (char)(i * 7 + l);
+		inputs[l] = input[l];
+		outputs[l] = output[l];
+	}
+	scrypt_1024_1_1_256_batch_kernel(romix, lanes, inputs, outputs, lanes);
+	for (l = 0; l < lanes; l++) {
+		scrypt_1024_1_1_256_sp_generic(input[l], expected, scratchpad);
+		if (memcmp(output[l], expected, 32))
+			return false;
+	}
+	return true;
+}
+
+/* Whether the OS saves the register state selected by mask (XCR0). */
+static bool scrypt_os_saves(uint32_t mask)
+{
+	uint32_t eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !((ecx >> 27) & 1))
+		return false;
+	uint32_t xcr0_lo, xcr0_hi;
+	__asm__ ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+	return (xcr0_lo & mask) == mask;
+}
+#endif
+
+std::string scrypt_batch_autodetect()
+{
+#if defined(ENABLE_AVX2) || defined(ENABLE_AVX512F)
+	uint32_t eax, ebx, ecx, edx;
+	if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+#if defined(ENABLE_AVX512F)
+		if (((ebx >> 16) & 1) && scrypt_os_saves(0xe6) && scrypt_batch_selftest(scrypt_avx512::ROMix_16way, 16)) {
+			ROMix_batch = scrypt_avx512::ROMix_16way;
+			ROMix_batch_lanes = 16;
+			return "avx512 (16-way)";
+		}
+#endif
+#if defined(ENABLE_AVX2)
+		if (((ebx >> 5) & 1) && scrypt_os_saves(0x6) && scrypt_batch_selftest(scrypt_avx2::ROMix_8way, 8)) {
+			ROMix_batch = scrypt_avx2::ROMix_8way;
+			ROMix_batch_lanes = 8;
+			return "avx2 (8-way)";
+		}
+#endif
+	}
+#endif
+	ROMix_batch = NULL;
+	ROMix_batch_lanes = 1;
+	return "standard";
+}
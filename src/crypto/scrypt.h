@@ -5,11 +5,20 @@
 
 static const int SCRYPT_SCRATCHPAD_SIZE = 131072 + 63;
 
+#include <string>
+
 void scrypt_1024_1_1_256(const char *input, char *output);
 void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scratchpad);
 
+/** Hash count independent 80-byte inputs, using the multi-buffer kernel selected
+ *  by scrypt_batch_autodetect() for as many of them as possible. */
+void scrypt_1024_1_1_256_batch(const char* const *inputs, char* const *outputs, size_t count);
+/** Autodetect the best available multi-buffer scrypt kernel. Returns its name. */
+std::string scrypt_batch_autodetect();
+/** Number of hashes the selected multi-buffer kernel computes at once (1 if none). */
+size_t scrypt_batch_lanes();
+
 #if defined(USE_SSE2)
-#include <string>
 #if defined(_M_X64) || defined(__x86_64__) || defined(_M_AMD64) || (defined(MAC_OSX) && defined(__i386__))
 #define USE_SSE2_ALWAYS 1
 #define scrypt_1024_1_1_256_sp(input, output, scratchpad) scrypt_1024_1_1_256_sp_sse2((input), (output), (scratchpad))
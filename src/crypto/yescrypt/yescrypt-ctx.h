@@ -0,0 +1,81 @@
+// Copyright (c) 2018 The Litebitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef _YESCRYPT_CTX_H_
+#define _YESCRYPT_CTX_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reusable state for the proof of work hash (N = 4096, r = 32): the dummy
+ * ROM and the 16 MiB scratch region, which is allocated on first use (backed
+ * by huge pages where available) and kept for later hashes.  A context must only be used by one thread at a
+ * time.
+ */
+typedef struct yescrypt_ctx yescrypt_ctx_t;
+
+/**
+ * yescrypt_ctx_new():
+ * Create an empty context; returns NULL on allocation failure.
+ */
+yescrypt_ctx_t *yescrypt_ctx_new(void);
+
+/**
+ * yescrypt_ctx_free(ctx):
+ * Free a context and its scratch region.  ctx may be NULL.
+ */
+void yescrypt_ctx_free(yescrypt_ctx_t *ctx);
+
+/**
+ * yescrypt_ctx_size(ctx):
+ * Return the size in bytes of the scratch region currently held by ctx.
+ */
+size_t yescrypt_ctx_size(const yescrypt_ctx_t *ctx);
+
+/**
+ * yescrypt_hash_ctx(ctx, input, output):
+ * Compute the proof of work hash of the 80-byte input into output.
+ * Return 0 on success; or -1 on error, in which case output is set to all
+ * 0xff bytes so that it cannot meet any target.
+ */
+int yescrypt_hash_ctx(yescrypt_ctx_t *ctx, const char *input, char *output);
+
+/**
+ * yescrypt_hash_batch(ctx, inputs, outputs, count):
+ * Compute count proof of work hashes reusing the scratch region of ctx.
+ * Return 0 on success; or -1 if any of them failed (see yescrypt_hash_ctx).
+ */
+int yescrypt_hash_batch(yescrypt_ctx_t *ctx, const char * const *inputs,
+    char * const *outputs, size_t count);
+
+/**
+ * yescrypt_thread_ctx():
+ * Return the calling thread's context, creating it on first use.  It is
+ * freed when the thread exits or on yescrypt_thread_ctx_release().
+ */
+yescrypt_ctx_t *yescrypt_thread_ctx(void);
+
+/**
+ * yescrypt_thread_ctx_release():
+ * Free the calling thread's context, if any.
+ */
+void yescrypt_thread_ctx_release(void);
+
+/**
+ * yescrypt_hash(input, output):
+ * Compute the proof of work hash of the 80-byte input with the calling
+ * thread's context.  Return 0 on success; or -1 on error (see
+ * yescrypt_hash_ctx).
+ */
+int yescrypt_hash(const char *input, char *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !_YESCRYPT_CTX_H_ */
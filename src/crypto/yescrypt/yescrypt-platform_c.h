@@ -18,7 +18,17 @@
  * SUCH DAMAGE.
  */
 
-//#include <sys/mman.h>
+/*
+ * Only mmap() the regions when configured to (--enable-yescrypt-mmap); the
+ * allocator below falls back to posix_memalign() or malloc() without
+ * MAP_ANON.
+ */
+#if defined(HAVE_CONFIG_H)
+#include "bitcoin-config.h"
+#endif
+#ifdef USE_YESCRYPT_MMAP
+#include <sys/mman.h>
+#endif
 
 #define HUGEPAGE_THRESHOLD		(12 * 1024 * 1024)
 
@@ -65,6 +75,14 @@ alloc_region(yescrypt_region_t * region, size_t size)
 #endif
 	if (base == MAP_FAILED)
 		base = NULL;
+#if defined(MADV_HUGEPAGE) && defined(MAP_HUGETLB)
+/*
+ * Without reserved huge pages MAP_HUGETLB fails, so ask for transparent huge
+ * pages instead; this cuts TLB misses on the random reads of V.
+ */
+	else if (size >= HUGEPAGE_THRESHOLD && !(flags & MAP_HUGETLB))
+		madvise(base, base_size, MADV_HUGEPAGE);
+#endif
 	aligned = base;
 #elif defined(HAVE_POSIX_MEMALIGN)
 	if ((errno = posix_memalign((void **)&base, 64, size)) != 0)
@@ -27,83 +27,159 @@
 #define YESCRYPT_T 0
 #define YESCRYPT_FLAGS (YESCRYPT_RW | YESCRYPT_PWXFORM)
 
-#ifdef __clang__
+#include <string.h>
 
-static int yescrypt_wavi(const uint8_t *passwd, size_t passwdlen,
-                            const uint8_t *salt, size_t saltlen,
-                            uint8_t *buf, size_t buflen)
-{
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "yescrypt-ctx.h"
+
+struct yescrypt_ctx {
     yescrypt_shared_t shared;
     yescrypt_local_t local;
-    int retval;
-    
-    if (yescrypt_init_shared(&shared, NULL, 0,
-                             0, 0, 0, YESCRYPT_SHARED_DEFAULTS, 0, NULL, 0))
-        return -1;
-    if (yescrypt_init_local(&local)) {
-        yescrypt_free_shared(&shared);
-        return -1;
+};
+
+yescrypt_ctx_t *yescrypt_ctx_new(void)
+{
+    yescrypt_ctx_t *ctx = malloc(sizeof(yescrypt_ctx_t));
+    if (!ctx)
+        return NULL;
+    /* "shared" could in fact be shared, but it's simpler to keep it private
+     * along with "local".  It's dummy and tiny anyway. */
+    if (yescrypt_init_shared(&ctx->shared, NULL, 0,
+                             0, 0, 0, YESCRYPT_SHARED_DEFAULTS, 0, NULL, 0)) {
+        free(ctx);
+        return NULL;
     }
-    retval = yescrypt_kdf(&shared, &local, passwd, passwdlen, salt, saltlen,
-                          YESCRYPT_N, YESCRYPT_R, YESCRYPT_P, YESCRYPT_T,
-                          YESCRYPT_FLAGS, buf, buflen);
-    if (yescrypt_free_local(&local)) {
-        yescrypt_free_shared(&shared);
-        return -1;
+    if (yescrypt_init_local(&ctx->local)) {
+        yescrypt_free_shared(&ctx->shared);
+        free(ctx);
+        return NULL;
     }
-    if (yescrypt_free_shared(&shared))
-        return -1;
-    
-    return retval;
+    return ctx;
 }
 
-#else
+void yescrypt_ctx_free(yescrypt_ctx_t *ctx)
+{
+    if (!ctx)
+        return;
+    yescrypt_free_local(&ctx->local);
+    yescrypt_free_shared(&ctx->shared);
+    free(ctx);
+}
+
+size_t yescrypt_ctx_size(const yescrypt_ctx_t *ctx)
+{
+    return ctx->local.base_size;
+}
 
-static int yescrypt_wavi(const uint8_t *passwd, size_t passwdlen,
+static int yescrypt_wavi(yescrypt_ctx_t *ctx,
+                            const uint8_t *passwd, size_t passwdlen,
                             const uint8_t *salt, size_t saltlen,
                             uint8_t *buf, size_t buflen)
 {
-    static __thread int initialized = 0;
-    static __thread yescrypt_shared_t shared;
-    static __thread yescrypt_local_t local;
-    int retval;
-    if (!initialized) {
-        /* "shared" could in fact be shared, but it's simpler to keep it private
-         * along with "local".  It's dummy and tiny anyway. */
-        if (yescrypt_init_shared(&shared, NULL, 0,
-                                 0, 0, 0, YESCRYPT_SHARED_DEFAULTS, 0, NULL, 0))
-            return -1;
-        if (yescrypt_init_local(&local)) {
-            yescrypt_free_shared(&shared);
-            return -1;
-        }
-        initialized = 1;
+    int retval = yescrypt_kdf(&ctx->shared, &ctx->local, passwd, passwdlen,
+                              salt, saltlen,
+                              YESCRYPT_N, YESCRYPT_R, YESCRYPT_P, YESCRYPT_T,
+                              YESCRYPT_FLAGS, buf, buflen);
+    if (retval < 0) {
+        /* Drop the scratch region; the next call allocates it again */
+        yescrypt_free_local(&ctx->local);
+        yescrypt_init_local(&ctx->local);
     }
-    retval = yescrypt_kdf(&shared, &local, passwd, passwdlen, salt, saltlen,
-                          YESCRYPT_N, YESCRYPT_R, YESCRYPT_P, YESCRYPT_T,
-                          YESCRYPT_FLAGS, buf, buflen);
-#if 0
-    if (yescrypt_free_local(&local)) {
-        yescrypt_free_shared(&shared);
+    return retval;
+}
+
+int yescrypt_hash_ctx(yescrypt_ctx_t *ctx, const char *input, char *output)
+{
+    if (yescrypt_wavi(ctx, (const uint8_t *) input, 80,
+                      (const uint8_t *) input, 80,
+                      (uint8_t *) output, 32) < 0) {
+        /* The highest possible hash, which meets no target */
+        memset(output, 0xff, 32);
         return -1;
     }
-    if (yescrypt_free_shared(&shared))
-        return -1;
-    initialized = 0;
-#endif
-    if (retval < 0) {
-        yescrypt_free_local(&local);
-        yescrypt_free_shared(&shared);
+    return 0;
+}
+
+int yescrypt_hash_batch(yescrypt_ctx_t *ctx, const char * const *inputs,
+                        char * const *outputs, size_t count)
+{
+    size_t i;
+    int retval = 0;
+
+    for (i = 0; i < count; i++) {
+        if (yescrypt_hash_ctx(ctx, inputs[i], outputs[i]) < 0)
+            retval = -1;
     }
     return retval;
 }
 
-#endif
+#ifndef _WIN32
+
+static pthread_key_t thread_ctx_key;
+static pthread_once_t thread_ctx_once = PTHREAD_ONCE_INIT;
+
+static void thread_ctx_free(void *ctx)
+{
+    yescrypt_ctx_free((yescrypt_ctx_t *) ctx);
+}
+
+static void thread_ctx_key_init(void)
+{
+    pthread_key_create(&thread_ctx_key, thread_ctx_free);
+}
+
+yescrypt_ctx_t *yescrypt_thread_ctx(void)
+{
+    yescrypt_ctx_t *ctx;
 
-void yescrypt_hash(const char *input, char *output)
+    pthread_once(&thread_ctx_once, thread_ctx_key_init);
+    ctx = pthread_getspecific(thread_ctx_key);
+    if (!ctx && (ctx = yescrypt_ctx_new()) != NULL)
+        pthread_setspecific(thread_ctx_key, ctx);
+    return ctx;
+}
+
+void yescrypt_thread_ctx_release(void)
 {
-    yescrypt_wavi((const uint8_t *) input, 80,
-                     (const uint8_t *) input, 80,
-                     (uint8_t *) output, 32);
+    pthread_once(&thread_ctx_once, thread_ctx_key_init);
+    yescrypt_ctx_free(pthread_getspecific(thread_ctx_key));
+    pthread_setspecific(thread_ctx_key, NULL);
 }
 
+#else
+
+/* No thread exit hook here: the context lives until released explicitly */
+static __thread yescrypt_ctx_t *thread_ctx = NULL;
+
+yescrypt_ctx_t *yescrypt_thread_ctx(void)
+{
+    if (!thread_ctx)
+        thread_ctx = yescrypt_ctx_new();
+    return thread_ctx;
+}
+
+void yescrypt_thread_ctx_release(void)
+{
+    yescrypt_ctx_free(thread_ctx);
+    thread_ctx = NULL;
+}
+
+#endif
+
+int yescrypt_hash(const char *input, char *output)
+{
+    int retval;
+    yescrypt_ctx_t *ctx = yescrypt_thread_ctx();
+    if (ctx)
+        return yescrypt_hash_ctx(ctx, input, output);
+    if ((ctx = yescrypt_ctx_new()) == NULL) {
+        memset(output, 0xff, 32);
+        return -1;
+    }
+    retval = yescrypt_hash_ctx(ctx, input, output);
+    yescrypt_ctx_free(ctx);
+    return retval;
+}
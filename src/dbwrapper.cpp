@@ -5,8 +5,10 @@
 #include "dbwrapper.h"
 
 #include "fs.h"
+#include "sync.h"
 #include "util.h"
 #include "random.h"
+#include "utilstrencodings.h"
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -14,12 +16,26 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <set>
+#include <sstream>
 
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
+    //! Number of writes that waited for the memtable or level 0, see DBImpl::MakeRoomForWrite
+    std::atomic<uint64_t> nMemtableStalls{0};
+    std::atomic<uint64_t> nLevel0Stalls{0};
+
     // This code is adapted from posix_logger.h, which is why it is using vsprintf.
     // Please do not do this in normal code
     virtual void Logv(const char * format, va_list ap) override {
+            // LevelDB only reports write stalls through its log
+            if (strcmp(format, "Current memtable full; waiting...\n") == 0) {
+                nMemtableStalls++;
+            } else if (strcmp(format, "Too many L0 files; waiting...\n") == 0) {
+                nLevel0Stalls++;
+            }
             if (!LogAcceptCategory(BCLog::LEVELDB)) {
                 return;
             }
@@ -73,14 +89,123 @@ public:
     }
 };
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+/** LRU block cache that counts its hits and misses */
+class CBitcoinLevelDBCache : public leveldb::Cache {
+private:
+    std::unique_ptr<leveldb::Cache> cache;
+    size_t nCapacity;
+
+public:
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+
+    explicit CBitcoinLevelDBCache(size_t nCapacityIn) : cache(leveldb::NewLRUCache(nCapacityIn)), nCapacity(nCapacityIn) {}
+
+    Handle* Insert(const leveldb::Slice& key, void* value, size_t charge, void (*deleter)(const leveldb::Slice& key, void* value)) override
+    {
+        return cache->Insert(key, value, charge, deleter);
+    }
+
+    Handle* Lookup(const leveldb::Slice& key) override
+    {
+        Handle* handle = cache->Lookup(key);
+        if (handle) {
+            nHits++;
+        } else {
+            nMisses++;
+        }
+        return handle;
+    }
+
+    void Release(Handle* handle) override { cache->Release(handle); }
+    void* Value(Handle* handle) override { return cache->Value(handle); }
+    void Erase(const leveldb::Slice& key) override { cache->Erase(key); }
+    uint64_t NewId() override { return cache->NewId(); }
+    void Prune() override { cache->Prune(); }
+    size_t TotalCharge() const override { return cache->TotalCharge(); }
+
+    size_t GetCapacity() const { return nCapacity; }
+};
+
+bool ParseDBArg(const std::string& strArg, std::string& strName, int64_t& nValue)
+{
+    size_t nPos = strArg.find(':');
+    strName = nPos == std::string::npos ? "" : strArg.substr(0, nPos);
+    std::string strValue = nPos == std::string::npos ? strArg : strArg.substr(nPos + 1);
+    if (strValue.empty()) {
+        nValue = 1;
+        return true;
+    }
+    return ParseInt64(strValue, &nValue) && nValue >= 0;
+}
+
+/** Return the value of a -db* option for a database, preferring a value given for its name. */
+static int64_t GetDBArg(const std::string& strArg, const std::string& strDBName, int64_t nDefault)
+{
+    int64_t nResult = nDefault;
+    bool fNamed = false;
+    for (const std::string& strValue : gArgs.GetArgs(strArg)) {
+        std::string strName;
+        int64_t nValue;
+        if (!ParseDBArg(strValue, strName, nValue))
+            continue;
+        if (strName.empty() && !fNamed) {
+            nResult = nValue;
+        } else if (!strName.empty() && strName == strDBName) {
+            nResult = nValue;
+            fNamed = true;
+        }
+    }
+    return nResult;
+}
+
+bool DBCompressionAvailable()
+{
+    // Without Snappy, LevelDB silently stores blocks uncompressed when asked for
+    // kSnappyCompression, and its port layer is not visible from here. So write
+    // a compressible table to an in-memory database and look at its size.
+    static const bool fAvailable = [] {
+        std::unique_ptr<leveldb::Env> env(leveldb::NewMemEnv(leveldb::Env::Default()));
+        leveldb::Options options;
+        options.env = env.get();
+        options.create_if_missing = true;
+        options.compression = leveldb::kSnappyCompression;
+        leveldb::DB* pdb = nullptr;
+        if (!leveldb::DB::Open(options, "compression", &pdb).ok())
+            return false;
+        std::unique_ptr<leveldb::DB> db(pdb);
+        const size_t nValueSize = 1 << 16;
+        if (!db->Put(leveldb::WriteOptions(), "k", std::string(nValueSize, 'x')).ok())
+            return false;
+        db->CompactRange(nullptr, nullptr);
+        leveldb::Range range("a", "z");
+        uint64_t nSize = 0;
+        db->GetApproximateSizes(&range, 1, &nSize);
+        return nSize < nValueSize / 2;
+    }();
+    return fAvailable;
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, const std::string& strName, int& nBloomBits)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    // By default half of the cache holds blocks, and each of the up to two write
+    // buffers held in memory simultaneously gets a quarter
+    int64_t nBlockCacheMiB = GetDBArg("-dbblockcache", strName, -1);
+    int64_t nWriteBufferMiB = GetDBArg("-dbwritebuffer", strName, -1);
+    options.block_cache = new CBitcoinLevelDBCache(nBlockCacheMiB < 0 ? nCacheSize / 2 : (size_t)nBlockCacheMiB << 20);
+    options.write_buffer_size = nWriteBufferMiB < 0 ? nCacheSize / 4 : (size_t)nWriteBufferMiB << 20;
+    options.block_size = (size_t)GetDBArg("-dbblocksize", strName, DEFAULT_DB_BLOCK_SIZE) << 10;
+    nBloomBits = GetDBArg("-dbbloombits", strName, DEFAULT_DB_BLOOM_BITS);
+    options.filter_policy = nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(nBloomBits) : nullptr;
     options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    if (GetDBArg("-dbcompression", strName, DEFAULT_DB_COMPRESSION)) {
+        if (DBCompressionAvailable())
+            options.compression = leveldb::kSnappyCompression;
+        else
+            LogPrintf("LevelDB was built without Snappy, not compressing %s\n", strName.empty() ? "database" : strName);
+    }
+    options.max_open_files = GetDBArg("-dbmaxopenfiles", strName, DEFAULT_DB_MAX_OPEN_FILES);
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -90,14 +215,19 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+//! Open databases that have a name, for getdbstats
+static CCriticalSection cs_dbwrappers;
+static std::set<const CDBWrapper*> setDBWrappers;
+
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const std::string& name)
+    : m_name(name), m_path(path)
 {
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, m_name, m_bloom_bits);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -139,10 +269,19 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
+
+    if (!m_name.empty()) {
+        LOCK(cs_dbwrappers);
+        setDBWrappers.insert(this);
+    }
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    if (!m_name.empty()) {
+        LOCK(cs_dbwrappers);
+        setDBWrappers.erase(this);
+    }
     delete pdb;
     pdb = nullptr;
     delete options.filter_policy;
@@ -189,6 +328,58 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+CDBStats CDBWrapper::GetStats() const
+{
+    const CBitcoinLevelDBCache* cache = static_cast<const CBitcoinLevelDBCache*>(options.block_cache);
+    const CBitcoinLevelDBLogger* logger = static_cast<const CBitcoinLevelDBLogger*>(options.info_log);
+
+    CDBStats stats;
+    stats.strName = m_name;
+    stats.strPath = m_path.string();
+    stats.nMaxOpenFiles = options.max_open_files;
+    stats.nBlockSize = options.block_size;
+    stats.nBlockCacheSize = cache->GetCapacity();
+    stats.nWriteBufferSize = options.write_buffer_size;
+    stats.fCompression = options.compression != leveldb::kNoCompression;
+    stats.nBloomBits = m_bloom_bits;
+    stats.nBlockCacheUsage = cache->TotalCharge();
+    stats.nBlockCacheHits = cache->nHits;
+    stats.nBlockCacheMisses = cache->nMisses;
+    stats.nMemtableStalls = logger->nMemtableStalls;
+    stats.nLevel0Stalls = logger->nLevel0Stalls;
+
+    std::string strValue;
+    stats.nMemoryUsage = 0;
+    if (pdb->GetProperty("leveldb.approximate-memory-usage", &strValue))
+        ParseUInt64(strValue, &stats.nMemoryUsage);
+
+    // The stats property is a table with a line per non-empty level below three header lines
+    if (pdb->GetProperty("leveldb.stats", &strValue)) {
+        std::istringstream stream(strValue);
+        std::string strLine;
+        for (int i = 0; std::getline(stream, strLine); i++) {
+            CDBStats::Level level;
+            if (i >= 3 && sscanf(strLine.c_str(), "%d %d %lf %lf %lf %lf", &level.nLevel, &level.nFiles,
+                                 &level.dSizeMB, &level.dCompactionSeconds, &level.dReadMB, &level.dWrittenMB) == 6) {
+                stats.vLevels.push_back(level);
+            }
+        }
+    }
+    return stats;
+}
+
+std::vector<CDBStats> GetAllDBStats()
+{
+    std::vector<CDBStats> vStats;
+    {
+        LOCK(cs_dbwrappers);
+        for (const CDBWrapper* db : setDBWrappers)
+            vStats.push_back(db->GetStats());
+    }
+    std::sort(vStats.begin(), vStats.end(), [](const CDBStats& a, const CDBStats& b) { return a.strName < b.strName; });
+    return vStats;
+}
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
@@ -7,6 +7,7 @@
 
 #include "clientversion.h"
 #include "fs.h"
+#include "prevector.h"
 #include "serialize.h"
 #include "streams.h"
 #include "util.h"
@@ -16,9 +17,69 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <algorithm>
+#include <memory>
+#include <numeric>
+
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
+//! -dbmaxopenfiles default
+static const int DEFAULT_DB_MAX_OPEN_FILES = 64;
+//! -dbblocksize default (KiB)
+static const int DEFAULT_DB_BLOCK_SIZE = 4;
+//! -dbcompression default
+static const bool DEFAULT_DB_COMPRESSION = false;
+//! -dbbloombits default
+static const int DEFAULT_DB_BLOOM_BITS = 10;
+
+/**
+ * Parse one value of a -db* tuning option. Values are either "<n>", which
+ * applies to every database, or "<name>:<n>", which applies to the database
+ * with that name only. A bare option ("-dbcompression") means 1.
+ */
+bool ParseDBArg(const std::string& strArg, std::string& strName, int64_t& nValue);
+
+/** Whether LevelDB can compress table blocks, which needs it to be built with Snappy. */
+bool DBCompressionAvailable();
+
+/** LevelDB settings and statistics of an open database */
+struct CDBStats
+{
+    struct Level
+    {
+        int nLevel;
+        int nFiles;
+        double dSizeMB;
+        double dCompactionSeconds;
+        double dReadMB;
+        double dWrittenMB;
+    };
+
+    std::string strName;
+    std::string strPath;
+
+    int nMaxOpenFiles;
+    size_t nBlockSize;
+    size_t nBlockCacheSize;
+    size_t nWriteBufferSize;
+    bool fCompression;
+    int nBloomBits;
+
+    size_t nBlockCacheUsage;
+    uint64_t nBlockCacheHits;
+    uint64_t nBlockCacheMisses;
+    uint64_t nMemoryUsage;
+    //! Writes that waited for a memtable to be flushed
+    uint64_t nMemtableStalls;
+    //! Writes that waited for level 0 to be compacted
+    uint64_t nLevel0Stalls;
+    std::vector<Level> vLevels;
+};
+
+/** Statistics of all open databases that were given a name, ordered by name. */
+std::vector<CDBStats> GetAllDBStats();
+
 class dbwrapper_error : public std::runtime_error
 {
 public:
@@ -43,6 +104,82 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
 };
 
+/** Serializes a database key into a buffer that only uses the heap for keys
+ * longer than DBWRAPPER_PREALLOC_KEY_SIZE.
+ */
+class CDBKeyStream
+{
+private:
+    prevector<DBWRAPPER_PREALLOC_KEY_SIZE, char> vch;
+
+public:
+    void write(const char* pch, size_t nSize)
+    {
+        vch.insert(vch.end(), pch, pch + nSize);
+    }
+    template<typename T>
+    CDBKeyStream& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return (*this);
+    }
+    int GetVersion() const { return CLIENT_VERSION; }
+    int GetType() const { return SER_DISK; }
+
+    leveldb::Slice GetSlice() const { return leveldb::Slice(vch.data(), vch.size()); }
+};
+
+/** Deserializes a value straight from memory owned by LevelDB (or a buffer
+ * it was read into), undoing the obfuscation of the bytes as they are read
+ * instead of XORing a copy of the whole value first.
+ */
+class CDBValueReader
+{
+private:
+    const char* pbegin;
+    const char* pcur;
+    const char* pend;
+    const std::vector<unsigned char>& key;
+    bool fObfuscated;
+
+public:
+    CDBValueReader(const leveldb::Slice& slValue, const std::vector<unsigned char>& keyIn) :
+        pbegin(slValue.data()), pcur(slValue.data()), pend(slValue.data() + slValue.size()), key(keyIn),
+        fObfuscated(std::any_of(keyIn.begin(), keyIn.end(), [](unsigned char c) { return c != 0; })) {}
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CDBValueReader::read(): end of data");
+        memcpy(pch, pcur, nSize);
+        if (fObfuscated) {
+            // Keep XORing in step with CDataStream::Xor, which starts at the first byte of the value
+            for (size_t i = 0, j = (pcur - pbegin) % key.size(); i != nSize; i++) {
+                pch[i] ^= key[j++];
+                if (j == key.size())
+                    j = 0;
+            }
+        }
+        pcur += nSize;
+    }
+    void ignore(size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CDBValueReader::ignore(): end of data");
+        pcur += nSize;
+    }
+    template<typename T>
+    CDBValueReader& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+    int GetVersion() const { return CLIENT_VERSION; }
+    int GetType() const { return SER_DISK; }
+    size_t size() const { return pend - pcur; }
+    bool empty() const { return pcur == pend; }
+};
+
 /** Batch of changes queued to be written to a CDBWrapper */
 class CDBBatch
 {
@@ -135,11 +272,9 @@ public:
     void SeekToFirst();
 
     template<typename K> void Seek(const K& key) {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        CDBKeyStream ssKey;
         ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
-        piter->Seek(slKey);
+        piter->Seek(ssKey.GetSlice());
     }
 
     void Next();
@@ -147,7 +282,7 @@ public:
     template<typename K> bool GetKey(K& key) {
         leveldb::Slice slKey = piter->key();
         try {
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            CSpanReader ssKey(SER_DISK, CLIENT_VERSION, slKey.data(), slKey.data() + slKey.size());
             ssKey >> key;
         } catch (const std::exception&) {
             return false;
@@ -156,10 +291,8 @@ public:
     }
 
     template<typename V> bool GetValue(V& value) {
-        leveldb::Slice slValue = piter->value();
         try {
-            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+            CDBValueReader ssValue(piter->value(), dbwrapper_private::GetObfuscateKey(parent));
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
@@ -171,6 +304,13 @@ public:
         return piter->value().size();
     }
 
+    /** Copy the value without deserializing it, so that can happen later (or on another thread). */
+    void GetValueStream(CDataStream& ssValue) {
+        leveldb::Slice slValue = piter->value();
+        ssValue = CDataStream(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+    }
+
 };
 
 class CDBWrapper
@@ -198,6 +338,15 @@ private:
     //! the database itself
     leveldb::DB* pdb;
 
+    //! name used to select -db* settings and to report statistics, may be empty
+    std::string m_name;
+
+    //! location of the database
+    fs::path m_path;
+
+    //! the tuning settings the database was opened with
+    int m_bloom_bits;
+
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
@@ -209,6 +358,29 @@ private:
 
     std::vector<unsigned char> CreateObfuscateKey() const;
 
+    /** Get the value of slKey into strValue and deserialize it from there. LevelDB
+     * has no way to pin a value in its cache, so strValue is the only copy made;
+     * callers reading many keys pass the same buffer to reuse its allocation.
+     */
+    template <typename V>
+    bool ReadValue(const leveldb::ReadOptions& options, const leveldb::Slice& slKey, std::string& strValue, V& value) const
+    {
+        leveldb::Status status = pdb->Get(options, slKey, &strValue);
+        if (!status.ok()) {
+            if (status.IsNotFound())
+                return false;
+            LogPrintf("LevelDB read failure: %s\n", status.ToString());
+            dbwrapper_private::HandleError(status);
+        }
+        try {
+            CDBValueReader ssValue(strValue, obfuscate_key);
+            ssValue >> value;
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
@@ -217,34 +389,61 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] name        Name of the database for per-database -db* settings and
+     *                        getdbstats. Unnamed databases only use the global settings.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const std::string& name = "");
     ~CDBWrapper();
 
     template <typename K, typename V>
     bool Read(const K& key, V& value) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        CDBKeyStream ssKey;
         ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
-        }
-        try {
-            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(obfuscate_key);
-            ssValue >> value;
-        } catch (const std::exception&) {
-            return false;
+        return ReadValue(readoptions, ssKey.GetSlice(), strValue, value);
+    }
+
+    /**
+     * Read the values of several keys at once, from a single snapshot of the
+     * database. The keys are looked up in sorted order so that neighbouring
+     * keys are served from the same table blocks, and all values are read
+     * through one buffer.
+     *
+     * @param[in]  keys    Keys to look up, in any order.
+     * @param[out] values  values[i] is the value of keys[i], if found.
+     * @param[out] found   found[i] is set if keys[i] was found and its value read.
+     * @return the number of keys that were found.
+     */
+    template <typename K, typename V>
+    size_t MultiRead(const std::vector<K>& keys, std::vector<V>& values, std::vector<bool>& found) const
+    {
+        std::vector<CDBKeyStream> vKeys(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+            vKeys[i] << keys[i];
+        std::vector<size_t> vOrder(keys.size());
+        std::iota(vOrder.begin(), vOrder.end(), 0);
+        std::sort(vOrder.begin(), vOrder.end(), [&vKeys](size_t a, size_t b) {
+            return vKeys[a].GetSlice().compare(vKeys[b].GetSlice()) < 0;
+        });
+
+        values.resize(keys.size());
+        found.assign(keys.size(), false);
+
+        leveldb::ReadOptions options = readoptions;
+        std::shared_ptr<const leveldb::Snapshot> snapshot(pdb->GetSnapshot(), [this](const leveldb::Snapshot* s) { pdb->ReleaseSnapshot(s); });
+        options.snapshot = snapshot.get();
+
+        size_t nFound = 0;
+        std::string strValue;
+        for (size_t i : vOrder) {
+            if (ReadValue(options, vKeys[i].GetSlice(), strValue, values[i])) {
+                found[i] = true;
+                nFound++;
+            }
         }
-        return true;
+        return nFound;
     }
 
     template <typename K, typename V>
@@ -258,13 +457,11 @@ public:
     template <typename K>
     bool Exists(const K& key) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        CDBKeyStream ssKey;
         ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status = pdb->Get(readoptions, ssKey.GetSlice(), &strValue);
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -306,6 +503,9 @@ public:
      */
     bool IsEmpty();
 
+    /** Return the settings and LevelDB statistics of this database. */
+    CDBStats GetStats() const;
+
     template<typename K>
     size_t EstimateSize(const K& key_begin, const K& key_end) const
     {
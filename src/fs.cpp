@@ -1,5 +1,12 @@
 #include "fs.h"
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace fsbridge {
 
 FILE *fopen(const fs::path& p, const char *mode)
@@ -12,4 +19,31 @@ FILE *freopen(const fs::path& p, const char *mode, FILE *stream)
     return ::freopen(p.string().c_str(), mode, stream);
 }
 
+MappedFile::~MappedFile()
+{
+#ifndef WIN32
+    munmap(const_cast<char*>(pdata), nSize);
+#endif
+}
+
+std::shared_ptr<const MappedFile> mmap(const fs::path& p)
+{
+#ifndef WIN32
+    int fd = ::open(p.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+    struct stat st;
+    void* pdata = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        pdata = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (pdata == MAP_FAILED)
+        return nullptr;
+    return std::make_shared<const MappedFile>(static_cast<const char*>(pdata), st.st_size);
+#else
+    return nullptr;
+#endif
+}
+
 } // fsbridge
@@ -6,6 +6,7 @@
 #define BITCOIN_FS_H
 
 #include <stdio.h>
+#include <memory>
 #include <string>
 
 #include <boost/filesystem.hpp>
@@ -19,6 +20,32 @@ namespace fs = boost::filesystem;
 namespace fsbridge {
     FILE *fopen(const fs::path& p, const char *mode);
     FILE *freopen(const fs::path& p, const char *mode, FILE *stream);
+
+    /** Read-only memory mapping of a whole file, unmapped on destruction. */
+    class MappedFile
+    {
+    public:
+        MappedFile(const char* pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return pdata; }
+        size_t size() const { return nSize; }
+
+    private:
+        const char* pdata;
+        size_t nSize;
+    };
+
+    /**
+     * Map the file at p. Returns nullptr if that fails, or is not supported (Windows).
+     *
+     * Reads from the mapping cannot fail the way fread() does: an I/O error
+     * while a page is loaded, or a read past the end of a file that has been
+     * truncated, raises SIGBUS and terminates the process.
+     */
+    std::shared_ptr<const MappedFile> mmap(const fs::path& p);
 };
 
 #endif // BITCOIN_FS_H
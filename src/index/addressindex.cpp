@@ -0,0 +1,291 @@
+// Copyright (c) 2018 The Litebitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/addressindex.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "crypto/sha256.h"
+#include "script/script.h"
+#include "undo.h"
+#include "util.h"
+#include "validation.h"
+
+#include <limits>
+#include <map>
+
+static const char DB_ADDRESS_HISTORY = 'h';
+static const char DB_ADDRESS_UNSPENT = 'u';
+static const char DB_ADDRESS_BALANCE = 'b';
+
+std::unique_ptr<AddressIndex> g_addressindex;
+
+namespace {
+
+/** Height of a balance snapshot, stored inverted so that the newest sorts first */
+struct BalanceHeight
+{
+    uint32_t nHeight;
+
+    explicit BalanceHeight(uint32_t nHeightIn = 0) : nHeight(nHeightIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata32be(s, ~nHeight);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        nHeight = ~ser_readdata32be(s);
+    }
+};
+
+typedef std::pair<char, std::pair<uint256, CAddressHistoryPos> > HistoryKey;
+typedef std::pair<uint256, CAmount> HistoryValue;
+typedef std::pair<char, std::pair<uint256, CAddressUnspentPos> > UnspentKey;
+typedef std::pair<uint32_t, CAmount> UnspentValue;
+typedef std::pair<char, std::pair<uint256, BalanceHeight> > BalanceKey;
+
+HistoryKey MakeHistoryKey(const uint256& scripthash, const CAddressHistoryPos& pos)
+{
+    return std::make_pair(DB_ADDRESS_HISTORY, std::make_pair(scripthash, pos));
+}
+
+UnspentKey MakeUnspentKey(const uint256& scripthash, const COutPoint& outpoint)
+{
+    return std::make_pair(DB_ADDRESS_UNSPENT, std::make_pair(scripthash, CAddressUnspentPos(outpoint.hash, outpoint.n)));
+}
+
+BalanceKey MakeBalanceKey(const uint256& scripthash, uint32_t nHeight)
+{
+    return std::make_pair(DB_ADDRESS_BALANCE, std::make_pair(scripthash, BalanceHeight(nHeight)));
+}
+
+} // namespace
+
+/** Access to the address index database (indexes/addressindex/) */
+class AddressIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /** Read the newest balance snapshot of a script at or below nHeight. */
+    bool ReadBalance(const uint256& scripthash, uint32_t nHeight, CAddressBalance& balance);
+};
+
+AddressIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe, false, "addressindex")
+{}
+
+bool AddressIndex::DB::ReadBalance(const uint256& scripthash, uint32_t nHeight, CAddressBalance& balance)
+{
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(MakeBalanceKey(scripthash, nHeight));
+    BalanceKey key;
+    if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESS_BALANCE && key.second.first == scripthash) {
+        return pcursor->GetValue(balance);
+    }
+    balance = CAddressBalance();
+    return true;
+}
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(new AddressIndex::DB(n_cache_size, f_memory, f_wipe))
+{}
+
+AddressIndex::~AddressIndex() {}
+
+uint256 AddressIndex::GetScriptHash(const CScript& script)
+{
+    uint256 hash;
+    CSHA256().Write(script.data(), script.size()).Finalize(hash.begin());
+    return hash;
+}
+
+/** Read the undo data of a block, which holds the outputs its inputs spent. */
+static bool ReadBlockUndo(const CBlock& block, CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    if (!UndoReadFromDisk(blockundo, pindex)) {
+        return false;
+    }
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: block and undo data of %s are inconsistent", __func__, pindex->GetBlockHash().ToString());
+    }
+    return true;
+}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The outputs of the genesis block are not spendable
+    if (pindex->nHeight == 0) {
+        return true;
+    }
+
+    CBlockUndo blockundo;
+    if (!ReadBlockUndo(block, blockundo, pindex)) {
+        return false;
+    }
+
+    CDBBatch batch(*m_db);
+    std::map<uint256, CAddressBalance> mapChanged;
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txid = tx.GetHash();
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                const CTxOut& prevout = txundo.vprevout[j].out;
+                uint256 scripthash = GetScriptHash(prevout.scriptPubKey);
+                batch.Write(MakeHistoryKey(scripthash, CAddressHistoryPos(pindex->nHeight, i, true, j)), HistoryValue(txid, prevout.nValue));
+                batch.Erase(MakeUnspentKey(scripthash, tx.vin[j].prevout));
+                mapChanged[scripthash].nBalance -= prevout.nValue;
+            }
+        }
+        for (unsigned int j = 0; j < tx.vout.size(); j++) {
+            const CTxOut& out = tx.vout[j];
+            if (out.scriptPubKey.IsUnspendable()) {
+                continue;
+            }
+            uint256 scripthash = GetScriptHash(out.scriptPubKey);
+            batch.Write(MakeHistoryKey(scripthash, CAddressHistoryPos(pindex->nHeight, i, false, j)), HistoryValue(txid, out.nValue));
+            batch.Write(MakeUnspentKey(scripthash, COutPoint(txid, j)), UnspentValue(pindex->nHeight, out.nValue));
+            CAddressBalance& change = mapChanged[scripthash];
+            change.nBalance += out.nValue;
+            change.nReceived += out.nValue;
+        }
+    }
+
+    // Snapshot the new balances on top of the ones before this block, so
+    // writing the same block twice gives the same result.
+    for (const auto& changed : mapChanged) {
+        CAddressBalance balance;
+        if (!m_db->ReadBalance(changed.first, pindex->nHeight - 1, balance)) {
+            return error("%s: Failed to read balance", __func__);
+        }
+        balance.nBalance += changed.second.nBalance;
+        balance.nReceived += changed.second.nReceived;
+        batch.Write(MakeBalanceKey(changed.first, pindex->nHeight), balance);
+    }
+
+    // Unlike the entries of other indexes, these are wrong for any other
+    // chain, so the best block moves with them. Otherwise, after a crash,
+    // the index could resume below them on a different branch and never
+    // rewind them.
+    {
+        LOCK(cs_main);
+        m_db->WriteBestBlock(batch, chainActive.GetLocator(pindex));
+    }
+    return m_db->WriteBatch(batch);
+}
+
+bool AddressIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        if (pindex->nHeight == 0 || !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            continue;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        CBlockUndo blockundo;
+        if (!ReadBlockUndo(block, blockundo, pindex)) {
+            return false;
+        }
+
+        // Undo the block in reverse, so outputs created and spent within it
+        // end up removed.
+        CDBBatch batch(*m_db);
+        for (unsigned int i = block.vtx.size(); i-- > 0;) {
+            const CTransaction& tx = *block.vtx[i];
+            const uint256& txid = tx.GetHash();
+            for (unsigned int j = 0; j < tx.vout.size(); j++) {
+                const CTxOut& out = tx.vout[j];
+                if (out.scriptPubKey.IsUnspendable()) {
+                    continue;
+                }
+                uint256 scripthash = GetScriptHash(out.scriptPubKey);
+                batch.Erase(MakeHistoryKey(scripthash, CAddressHistoryPos(pindex->nHeight, i, false, j)));
+                batch.Erase(MakeUnspentKey(scripthash, COutPoint(txid, j)));
+                batch.Erase(MakeBalanceKey(scripthash, pindex->nHeight));
+            }
+            if (i > 0) {
+                const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+                for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                    const Coin& coin = txundo.vprevout[j];
+                    uint256 scripthash = GetScriptHash(coin.out.scriptPubKey);
+                    batch.Erase(MakeHistoryKey(scripthash, CAddressHistoryPos(pindex->nHeight, i, true, j)));
+                    batch.Write(MakeUnspentKey(scripthash, tx.vin[j].prevout), UnspentValue(coin.nHeight, coin.out.nValue));
+                    batch.Erase(MakeBalanceKey(scripthash, pindex->nHeight));
+                }
+            }
+        }
+        {
+            LOCK(cs_main);
+            m_db->WriteBestBlock(batch, chainActive.GetLocator(pindex->pprev));
+        }
+        if (!m_db->WriteBatch(batch)) {
+            return error("%s: Failed to rewind block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& AddressIndex::GetDB() const { return *m_db; }
+
+bool AddressIndex::FindHistory(const uint256& scripthash, const CAddressHistoryPos& start, size_t nCount,
+                               std::vector<CAddressHistoryEntry>& entries, bool& fMore, CAddressHistoryPos& next) const
+{
+    fMore = false;
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    for (pcursor->Seek(MakeHistoryKey(scripthash, start)); pcursor->Valid(); pcursor->Next()) {
+        HistoryKey key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESS_HISTORY || key.second.first != scripthash) {
+            break;
+        }
+        if (entries.size() == nCount) {
+            fMore = true;
+            next = key.second.second;
+            break;
+        }
+        HistoryValue value;
+        if (!pcursor->GetValue(value)) {
+            return error("%s: Failed to read history entry", __func__);
+        }
+        entries.push_back(CAddressHistoryEntry{key.second.second, value.first, value.second});
+    }
+    return true;
+}
+
+bool AddressIndex::FindUnspent(const uint256& scripthash, const CAddressUnspentPos& start, size_t nCount,
+                               std::vector<CAddressUnspentEntry>& entries, bool& fMore, CAddressUnspentPos& next) const
+{
+    fMore = false;
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    for (pcursor->Seek(std::make_pair(DB_ADDRESS_UNSPENT, std::make_pair(scripthash, start))); pcursor->Valid(); pcursor->Next()) {
+        UnspentKey key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESS_UNSPENT || key.second.first != scripthash) {
+            break;
+        }
+        if (entries.size() == nCount) {
+            fMore = true;
+            next = key.second.second;
+            break;
+        }
+        UnspentValue value;
+        if (!pcursor->GetValue(value)) {
+            return error("%s: Failed to read unspent output", __func__);
+        }
+        entries.push_back(CAddressUnspentEntry{key.second.second, value.first, value.second});
+    }
+    return true;
+}
+
+bool AddressIndex::FindBalance(const uint256& scripthash, CAddressBalance& balance) const
+{
+    return m_db->ReadBalance(scripthash, std::numeric_limits<uint32_t>::max(), balance);
+}
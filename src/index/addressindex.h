@@ -0,0 +1,156 @@
+// Copyright (c) 2018 The Litebitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_ADDRESSINDEX_H
+#define BITCOIN_INDEX_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "index/base.h"
+#include "serialize.h"
+
+#include <memory>
+#include <vector>
+
+class CScript;
+
+/** Position of an entry in the history of a script, in block chain order */
+struct CAddressHistoryPos
+{
+    uint32_t nHeight;
+    uint32_t nTxPos;   //!< position of the transaction in its block
+    uint8_t fSpent;    //!< whether the entry spends an output rather than creates one
+    uint32_t nIndex;   //!< input index if fSpent, else output index
+
+    CAddressHistoryPos() : nHeight(0), nTxPos(0), fSpent(0), nIndex(0) {}
+    CAddressHistoryPos(uint32_t nHeightIn, uint32_t nTxPosIn, bool fSpentIn, uint32_t nIndexIn) :
+        nHeight(nHeightIn), nTxPos(nTxPosIn), fSpent(fSpentIn), nIndex(nIndexIn) {}
+
+    // Big endian, so that the database keeps the entries ordered by position
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata32be(s, nHeight);
+        ser_writedata32be(s, nTxPos);
+        ser_writedata8(s, fSpent);
+        ser_writedata32be(s, nIndex);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        nHeight = ser_readdata32be(s);
+        nTxPos = ser_readdata32be(s);
+        fSpent = ser_readdata8(s);
+        nIndex = ser_readdata32be(s);
+    }
+};
+
+/** An output created or spent by a script */
+struct CAddressHistoryEntry
+{
+    CAddressHistoryPos pos;
+    uint256 txid;
+    CAmount nValue;
+};
+
+/** Position of an unspent output of a script, ordered by outpoint */
+struct CAddressUnspentPos
+{
+    uint256 txid;
+    uint32_t n;
+
+    CAddressUnspentPos() : n(0) {}
+    CAddressUnspentPos(const uint256& txidIn, uint32_t nIn) : txid(txidIn), n(nIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        s << txid;
+        ser_writedata32be(s, n);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        s >> txid;
+        n = ser_readdata32be(s);
+    }
+};
+
+/** An unspent output of a script */
+struct CAddressUnspentEntry
+{
+    CAddressUnspentPos pos;
+    uint32_t nHeight;
+    CAmount nValue;
+};
+
+/** Balance of a script, and the total it has ever received */
+struct CAddressBalance
+{
+    CAmount nBalance;
+    CAmount nReceived;
+
+    CAddressBalance() : nBalance(0), nReceived(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nBalance);
+        READWRITE(nReceived);
+    }
+};
+
+/**
+ * AddressIndex records, per output script, the outputs it created and spent,
+ * its unspent outputs and its balance. Scripts are keyed by their SHA256, so
+ * that every lookup is a seek in the database followed by a scan of the
+ * results only.
+ *
+ * Balances are stored as a snapshot per block that changed them, which keeps
+ * writing a block idempotent: after an unclean shutdown the index can simply
+ * write again the blocks after its last recorded best block.
+ */
+class AddressIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~AddressIndex() override;
+
+    /** The key the index uses for an output script. */
+    static uint256 GetScriptHash(const CScript& script);
+
+    /**
+     * Look up at most nCount history entries of a script, starting at start.
+     * If there are more, fMore is set and next is the position to continue at.
+     */
+    bool FindHistory(const uint256& scripthash, const CAddressHistoryPos& start, size_t nCount,
+                     std::vector<CAddressHistoryEntry>& entries, bool& fMore, CAddressHistoryPos& next) const;
+
+    /** Look up at most nCount unspent outputs of a script, like FindHistory. */
+    bool FindUnspent(const uint256& scripthash, const CAddressUnspentPos& start, size_t nCount,
+                     std::vector<CAddressUnspentEntry>& entries, bool& fMore, CAddressUnspentPos& next) const;
+
+    /** Look up the current balance of a script. */
+    bool FindBalance(const uint256& scripthash, CAddressBalance& balance) const;
+};
+
+/// The global address index. May be null.
+extern std::unique_ptr<AddressIndex> g_addressindex;
+
+#endif // BITCOIN_INDEX_ADDRESSINDEX_H
@@ -0,0 +1,137 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BASE_H
+#define BITCOIN_INDEX_BASE_H
+
+#include "dbwrapper.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "threadinterrupt.h"
+#include "uint256.h"
+#include "validationinterface.h"
+
+#include <atomic>
+#include <thread>
+
+class CBlockIndex;
+
+/**
+ * Base class for indices of blockchain data. This implements
+ * CValidationInterface and ensures blocks are indexed sequentially according
+ * to their position in the active chain.
+ *
+ * An index is built on its own thread: after Start() it catches up from the
+ * best block it has recorded, reading blocks from disk, and from then on it
+ * follows the chain through BlockConnected notifications. Validation never
+ * waits for it.
+ */
+class BaseIndex : public CValidationInterface
+{
+protected:
+    /** The database of an index, which also records the best block the index has caught up with. */
+    class DB : public CDBWrapper
+    {
+    public:
+        DB(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool fObfuscate = false, const std::string& name = "");
+
+        /** Read the locator of the block that the index is in sync with. */
+        bool ReadBestBlock(CBlockLocator& locator) const;
+
+        /** Write the locator of the block that the index is in sync with. */
+        bool WriteBestBlock(const CBlockLocator& locator);
+
+        /**
+         * Add the locator of the block that the index is in sync with to a
+         * batch, so that it is committed together with the entries of that block.
+         */
+        void WriteBestBlock(CDBBatch& batch, const CBlockLocator& locator);
+    };
+
+private:
+    /**
+     * Whether the index is in sync with the main chain. The flag is flipped
+     * from false to true once, after which point this starts processing
+     * validation interface notifications to stay in sync.
+     */
+    std::atomic<bool> m_synced;
+
+    /** The last block in the chain that the index is in sync with. */
+    std::atomic<const CBlockIndex*> m_best_block_index;
+
+    std::thread m_thread_sync;
+    CThreadInterrupt m_interrupt;
+
+    /**
+     * Sync the index with the block index starting from the current best
+     * block. Intended to be run in its own thread, m_thread_sync, and can be
+     * interrupted with m_interrupt. Once the index gets in sync, the m_synced
+     * flag is set and the BlockConnected callback takes over.
+     */
+    void ThreadSync();
+
+protected:
+    /** Write the locator of pindex as the best block of the index. */
+    bool WriteBestBlock(const CBlockIndex* pindex);
+
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
+                        const std::vector<CTransactionRef>& txnConflicted) override;
+
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& block) override;
+
+    void SetBestChain(const CBlockLocator& locator) override;
+
+    /** Initialize internal state from the database and block index. */
+    virtual bool Init();
+
+    /**
+     * Make the entries written so far durable, before the best block of the
+     * index is moved up to them. Indexes keeping data outside of their
+     * database flush it here.
+     */
+    virtual bool CommitInternal() { return true; }
+
+    /** Write update index entries for a newly connected block. */
+    virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
+
+    /**
+     * Rewind the index from current_tip back to its ancestor new_tip, after
+     * the blocks in between have been reorganized away. Indexes whose entries
+     * stay valid for stale blocks only need to record the new best block,
+     * which is what the default does.
+     */
+    virtual bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip);
+
+    virtual DB& GetDB() const = 0;
+
+    /** Get the name of the index for display in logs. */
+    virtual const char* GetName() const = 0;
+
+public:
+    BaseIndex();
+    /** Destructor interrupts sync thread if running and blocks until it exits. */
+    virtual ~BaseIndex();
+
+    /**
+     * Blocks the current thread until the index is caught up to the current
+     * state of the block chain. This only blocks if the index has gotten in
+     * sync once and only needs to process blocks in the validation interface
+     * queue. If the index is catching up from far behind, this method does
+     * not block and immediately returns false. Call without cs_main held.
+     */
+    bool BlockUntilSyncedToCurrentChain();
+
+    void Interrupt();
+
+    /**
+     * Start initializes the sync state and registers the instance as a
+     * validation interface so that it stays in sync with blockchain updates.
+     */
+    bool Start();
+
+    /** Stops the instance from staying in sync with blockchain updates. */
+    void Stop();
+};
+
+#endif // BITCOIN_INDEX_BASE_H
@@ -8,13 +8,16 @@
 #include "amount.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "checkqueue.h"
 #include "coins.h"
 #include "consensus/consensus.h"
 #include "consensus/tx_verify.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
 #include "hash.h"
+#include "crypto/neoscrypt.h"
 #include "crypto/scrypt.h"
+#include "init.h"
 #include "validation.h"
 #include "net.h"
 #include "policy/feerate.h"
@@ -29,6 +32,7 @@
 #include "validationinterface.h"
 
 #include <algorithm>
+#include <mutex>
 #include <queue>
 #include <utility>
 
@@ -440,6 +444,143 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
     }
 }
 
+int nGenerateThreads = DEFAULT_GENERATE_THREADS;
+
+/**
+ * The nonce range of one block template, shared by the threads searching it.
+ * Nonces are handed out in batches so that each batch can be hashed with the
+ * multi-buffer PoW kernels. The search ends when a nonce passes, the range or
+ * nMaxTries is exhausted, or shutdown is requested.
+ */
+class CNonceSearch
+{
+private:
+    std::mutex cs;
+    uint32_t nNextNonce;
+    const uint32_t nEndNonce;
+    uint64_t& nMaxTries;
+    bool fFound;
+    uint32_t nFoundNonce;
+
+public:
+    CNonceSearch(uint32_t nStartNonce, uint32_t nEndNonceIn, uint64_t& nMaxTriesIn) :
+        nNextNonce(nStartNonce), nEndNonce(nEndNonceIn), nMaxTries(nMaxTriesIn), fFound(false), nFoundNonce(0) {}
+
+    /** Hand out up to nWant nonces starting at nStart. Returns false once the search is over. */
+    bool Claim(uint32_t nWant, uint32_t& nStart, uint32_t& nCount)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (fFound || nNextNonce >= nEndNonce || nMaxTries == 0 || ShutdownRequested())
+            return false;
+        nStart = nNextNonce;
+        nCount = std::min<uint64_t>(std::min(nWant, nEndNonce - nNextNonce), nMaxTries);
+        nNextNonce += nCount;
+        nMaxTries -= nCount;
+        return true;
+    }
+
+    /** Record a passing nonce; the lowest one found wins. */
+    void Found(uint32_t nNonce)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (!fFound || nNonce < nFoundNonce)
+            nFoundNonce = nNonce;
+        fFound = true;
+    }
+
+    bool GetFound(uint32_t& nNonce)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        nNonce = nFoundNonce;
+        return fFound;
+    }
+};
+
+/** Number of nonces a generate thread hashes at once: the lane count of the batch kernel of the header's PoW. */
+static uint32_t GetNonceBatchSize(const CBlockHeader& header)
+{
+    if (header.IsScryptPoW())
+        return scrypt_batch_lanes();
+    if (header.IsNeoscryptPoW())
+        return neoscrypt_batch_lanes();
+    return 1;
+}
+
+static void SearchNonces(CNonceSearch& search, const CBlockHeader& header, const Consensus::Params& params)
+{
+    const uint32_t nBatch = GetNonceBatchSize(header);
+    std::vector<CBlockHeader> batch(nBatch, header);
+    std::vector<const CBlockHeader*> headers;
+    uint32_t nStart, nCount;
+    while (search.Claim(nBatch, nStart, nCount)) {
+        headers.clear();
+        for (uint32_t i = 0; i < nCount; i++) {
+            batch[i].nNonce = nStart + i;
+            headers.push_back(&batch[i]);
+        }
+        std::vector<uint256> hashes = GetPoWHashes(headers);
+        for (uint32_t i = 0; i < nCount; i++) {
+            if (CheckProofOfWork(hashes[i], header.nBits, params)) {
+                search.Found(nStart + i);
+                break;
+            }
+        }
+    }
+}
+
+/** One generate thread's share of a CNonceSearch, run on noncesearchqueue */
+class CNonceSearchCheck
+{
+private:
+    CNonceSearch* psearch;
+    const CBlockHeader* pheader;
+    const Consensus::Params* pparams;
+
+public:
+    CNonceSearchCheck() : psearch(nullptr), pheader(nullptr), pparams(nullptr) {}
+    CNonceSearchCheck(CNonceSearch& search, const CBlockHeader& header, const Consensus::Params& params) :
+        psearch(&search), pheader(&header), pparams(&params) {}
+
+    bool operator()()
+    {
+        SearchNonces(*psearch, *pheader, *pparams);
+        return true;
+    }
+
+    void swap(CNonceSearchCheck& check)
+    {
+        std::swap(psearch, check.psearch);
+        std::swap(pheader, check.pheader);
+        std::swap(pparams, check.pparams);
+    }
+};
+
+/**
+ * Generate threads are started once and reused for every block template, so
+ * each keeps the PoW hashing context it allocated on its first hash.
+ */
+static CCheckQueue<CNonceSearchCheck> noncesearchqueue(1);
+
+void ThreadNonceSearch() {
+    RenameThread("bitcoin-genwork");
+    noncesearchqueue.Thread();
+}
+
+bool SearchBlockNonce(CBlock* pblock, uint32_t nEndNonce, uint64_t& nMaxTries, const Consensus::Params& params)
+{
+    CNonceSearch search(pblock->nNonce, nEndNonce, nMaxTries);
+    const CBlockHeader header = pblock->GetBlockHeader();
+    {
+        CCheckQueueControl<CNonceSearchCheck> control(&noncesearchqueue);
+        std::vector<CNonceSearchCheck> vChecks;
+        for (int i = 0; i < nGenerateThreads; i++)
+            vChecks.emplace_back(search, header, params);
+        control.Add(vChecks);
+        control.Wait();
+    }
+    return search.GetFound(pblock->nNonce);
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -21,6 +21,8 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default number of threads searching nonces in generate and generatetoaddress */
+static const int DEFAULT_GENERATE_THREADS = 1;
 
 struct CBlockTemplate
 {
@@ -202,6 +204,17 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx);
 };
 
+/** Number of threads searching nonces in generate and generatetoaddress, see -genproclimit */
+extern int nGenerateThreads;
+
+/** Run a generate thread, which helps SearchBlockNonce until shutdown */
+void ThreadNonceSearch();
+/**
+ * Search the nonces from pblock->nNonce up to nEndNonce on nGenerateThreads
+ * threads, the caller's included, trying at most nMaxTries of them. Sets
+ * pblock->nNonce and returns true if one gives valid proof of work.
+ */
+bool SearchBlockNonce(CBlock* pblock, uint32_t nEndNonce, uint64_t& nMaxTries, const Consensus::Params& params);
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
@@ -8,6 +8,7 @@
 #include "arith_uint256.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "crypto/common.h"
 #include "primitives/block.h"
 #include "uint256.h"
 #include "util.h"
@@ -95,6 +96,23 @@ unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nF
     return bnNew.GetCompact();
 }
 
+/**
+ * Done as one pass of 64-by-32 bit divisions over the words of a instead of a
+ * bitwise long division. The DarkGravityWave averages divide by the block
+ * count at every step, which made those divisions the bulk of the retarget cost.
+ */
+arith_uint256 DivideSmall(const arith_uint256& a, uint32_t b)
+{
+    uint256 n = ArithToUint256(a);
+    uint64_t rem = 0;
+    for (int i = 7; i >= 0; i--) {
+        const uint64_t cur = (rem << 32) | ReadLE32(n.begin() + 4 * i);
+        WriteLE32(n.begin() + 4 * i, cur / b);
+        rem = cur % b;
+    }
+    return UintToArith256(n);
+}
+
 unsigned int static DarkGravityWave(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) {
     /* current difficulty formula, dash - DarkGravity v3, written by Evan Duffield - evan@dash.org */
 	unsigned int nProofOfWorkLimit = UintToArith256(params.powLimit).GetCompact();
@@ -124,7 +142,7 @@ unsigned int static DarkGravityWave(const CBlockIndex* pindexLast, const CBlockH
 
         if(CountBlocks <= PastBlocksMin) {
             if (CountBlocks == 1) { PastDifficultyAverage.SetCompact(BlockReading->nBits); }
-            else { PastDifficultyAverage = ((PastDifficultyAveragePrev * CountBlocks) + (arith_uint256().SetCompact(BlockReading->nBits))) / (CountBlocks + 1); }
+            else { PastDifficultyAverage = DivideSmall((PastDifficultyAveragePrev * CountBlocks) + (arith_uint256().SetCompact(BlockReading->nBits)), CountBlocks + 1); }
             PastDifficultyAveragePrev = PastDifficultyAverage;
         }
 
@@ -177,7 +195,7 @@ unsigned int static DarkGravityWave_V2(const CBlockIndex* pindexLast, const Cons
             bnPastTargetAvg = bnTarget;
         } else {
             // NOTE: that's not an average really...
-            bnPastTargetAvg = (bnPastTargetAvg * nCountBlocks + bnTarget) / (nCountBlocks + 1);
+            bnPastTargetAvg = DivideSmall(bnPastTargetAvg * nCountBlocks + bnTarget, nCountBlocks + 1);
         }
 
         if(nCountBlocks != nPastBlocks) {
@@ -227,7 +245,7 @@ unsigned int static DarkGravityWave_V3(const CBlockIndex* pindexLast, const Cons
             bnPastTargetAvg = bnTarget;
         } else {
             // NOTE: that's not an average really...
-            bnPastTargetAvg = (bnPastTargetAvg * nCountBlocks + bnTarget) / (nCountBlocks + 1);
+            bnPastTargetAvg = DivideSmall(bnPastTargetAvg * nCountBlocks + bnTarget, nCountBlocks + 1);
         }
 
         if(nCountBlocks != nPastBlocks) {
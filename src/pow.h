@@ -12,6 +12,7 @@
 
 class CBlockHeader;
 class CBlockIndex;
+class arith_uint256;
 class uint256;
 
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params&);
@@ -20,4 +21,7 @@ unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nF
 /** Check whether a block hash satisfies the proof-of-work requirement specified by nBits */
 bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&);
 
+/** a / b for a non-zero 32-bit divisor, bit-exact with arith_uint256 division */
+arith_uint256 DivideSmall(const arith_uint256& a, uint32_t b);
+
 #endif // BITCOIN_POW_H
@@ -12,8 +12,9 @@
 #include "crypto/scrypt.h"
 #include "versionbits.h"
 #include "crypto/neoscrypt.h"
+#include "crypto/yescrypt/yescrypt-ctx.h"
 
-extern "C" void yescrypt_hash(const char *input, char *output);
+#include <new>
 
 uint256 CBlockHeader::GetHash() const
 {
@@ -30,7 +31,9 @@ uint256 CBlockHeader::GetPoWSHash() const
 uint256 CBlockHeader::GetPoWYHash() const
 {
     uint256 thash;
-    yescrypt_hash(BEGIN(nVersion), BEGIN(thash));
+    // Only fails when the scratch region cannot be allocated
+    if (yescrypt_hash(BEGIN(nVersion), BEGIN(thash)) < 0)
+        throw std::bad_alloc();
     return thash;
 }
 
@@ -59,6 +62,56 @@ uint256 CBlockHeader::GetPoWDHash() const
 		return GetPoWSHash();
 }
 
+bool CBlockHeader::IsScryptPoW() const
+{
+    return nVersion != 1879048192 && nVersion != 1610612736;
+}
+
+bool CBlockHeader::IsNeoscryptPoW() const
+{
+    return nVersion == 1610612736;
+}
+
+std::vector<uint256> GetPoWHashes(const std::vector<const CBlockHeader*>& headers)
+{
+    std::vector<uint256> hashes(headers.size());
+    std::vector<const char*> inputs;
+    std::vector<char*> outputs;
+    std::vector<const unsigned char*> nsinputs;
+    std::vector<unsigned char*> nsoutputs;
+    std::vector<const char*> yinputs;
+    std::vector<char*> youtputs;
+    for (size_t i = 0; i < headers.size(); i++) {
+        if (headers[i]->IsScryptPoW()) {
+            inputs.push_back(BEGIN(headers[i]->nVersion));
+            outputs.push_back(BEGIN(hashes[i]));
+        } else if (headers[i]->IsNeoscryptPoW()) {
+            nsinputs.push_back((const unsigned char*)&headers[i]->nVersion);
+            nsoutputs.push_back(hashes[i].begin());
+        } else {
+            yinputs.push_back(BEGIN(headers[i]->nVersion));
+            youtputs.push_back(BEGIN(hashes[i]));
+        }
+    }
+    if (!inputs.empty())
+        scrypt_1024_1_1_256_batch(&inputs[0], &outputs[0], inputs.size());
+    if (!nsinputs.empty())
+        neoscrypt_batch(&nsinputs[0], &nsoutputs[0], nsinputs.size());
+    if (!yinputs.empty()) {
+        yescrypt_ctx_t* ctx = yescrypt_thread_ctx();
+        int ret = 0;
+        if (ctx) {
+            ret = yescrypt_hash_batch(ctx, &yinputs[0], &youtputs[0], yinputs.size());
+        } else {
+            for (size_t i = 0; i < yinputs.size(); i++)
+                ret |= yescrypt_hash(yinputs[i], youtputs[i]);
+        }
+        if (ret < 0)
+            throw std::bad_alloc();
+    }
+    return hashes;
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
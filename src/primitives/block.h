@@ -71,7 +71,13 @@ public:
 	uint256 GetPoWYHash() const;
 	
 	uint256 GetPoWDHash() const;
-		
+
+    /** Whether GetPoWHash() is the plain scrypt hash, which can be batched with GetPoWHashes() */
+    bool IsScryptPoW() const;
+
+    /** Whether GetPoWHash() is the NeoScrypt hash, which can be batched with GetPoWHashes() */
+    bool IsNeoscryptPoW() const;
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
@@ -129,6 +135,10 @@ public:
     std::string ToString() const;
 };
 
+/** Compute the proof of work hashes of several headers, hashing the scrypt and
+ *  NeoScrypt ones together with the multi-buffer kernels. */
+std::vector<uint256> GetPoWHashes(const std::vector<const CBlockHeader*>& headers);
+
 /** Describes a place in the block chain to another node such that if the
  * other node doesn't have the same branch, it can find a recent common trunk.
  * The further back it is, the further before the fork it may be.
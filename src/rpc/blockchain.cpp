@@ -6,6 +6,7 @@
 #include "rpc/blockchain.h"
 
 #include "amount.h"
+#include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -13,10 +14,14 @@
 #include "consensus/validation.h"
 #include "validation.h"
 #include "core_io.h"
+#include "blockfilter.h"
+#include "index/addressindex.h"
+#include "index/blockfilterindex.h"
 #include "policy/feerate.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
+#include "script/standard.h"
 #include "streams.h"
 #include "sync.h"
 #include "txdb.h"
@@ -809,7 +814,7 @@ static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash,
 }
 
 //! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
+static bool GetUTXOStats(CCoinsViewDB *view, CCoinsStats &stats)
 {
     std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
 
@@ -820,6 +825,9 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
         stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
     }
     ss << stats.hashBlock;
+    // Start the rolling UTXO set hash here if it is not there yet
+    CTxOutSetHash txoutsethash;
+    const bool fStartTxOutSetHash = fTxOutSetHash && !view->ReadTxOutSetHash(stats.hashBlock, txoutsethash);
     uint256 prevkey;
     std::map<uint32_t, Coin> outputs;
     while (pcursor->Valid()) {
@@ -832,6 +840,8 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
                 outputs.clear();
             }
             prevkey = key.hash;
+            if (fStartTxOutSetHash)
+                txoutsethash.Insert(key, coin);
             outputs[key.n] = std::move(coin);
         } else {
             return error("%s: unable to read value", __func__);
@@ -843,6 +853,8 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
     }
     stats.hashSerialized = ss.GetHash();
     stats.nDiskSize = view->EstimateSize();
+    if (fStartTxOutSetHash && !view->WriteTxOutSetHash(stats.hashBlock, txoutsethash))
+        return error("%s: unable to write the UTXO set hash", __func__);
     return true;
 }
 
@@ -897,29 +909,77 @@ UniValue pruneblockchain(const JSONRPCRequest& request)
 
 UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 2)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" height )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, unless hash_type is txoutset_hash.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"   (string, optional, default=hash_serialized_2) Either \"hash_serialized_2\", which scans\n"
+            "                  the whole set, or \"txoutset_hash\", which looks up the rolling hash kept with -txoutsethash\n"
+            "2. height        (numeric, optional) With txoutset_hash, the height of the block to return the statistics for\n"
+            "                  (default: the tip)\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions (only with hash_serialized_2)\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (only with hash_serialized_2)\n"
+            "  \"txoutset_hash\": \"hash\", (string) The rolling hash (only with txoutset_hash)\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"txoutset_hash\" 1000")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
     UniValue ret(UniValue::VOBJ);
 
+    const std::string strHashType = request.params[0].isNull() ? "hash_serialized_2" : request.params[0].get_str();
+    if (strHashType == "txoutset_hash") {
+        if (!fTxOutSetHash)
+            throw JSONRPCError(RPC_MISC_ERROR, "The rolling UTXO set hash is only kept with -txoutsethash");
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            pindex = chainActive.Tip();
+            if (!request.params[1].isNull()) {
+                int nHeight = request.params[1].get_int();
+                if (nHeight < 0 || nHeight > chainActive.Height())
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+                pindex = chainActive[nHeight];
+            }
+        }
+        CTxOutSetHash txoutsethash;
+        if (!pcoinsdbview->ReadTxOutSetHash(pindex->GetBlockHash(), txoutsethash)) {
+            // Only the tip can be scanned, which also starts the rolling hash
+            if (!request.params[1].isNull())
+                throw JSONRPCError(RPC_MISC_ERROR, "No UTXO set hash is stored for this block");
+            CCoinsStats stats;
+            FlushStateToDisk();
+            if (!GetUTXOStats(pcoinsdbview, stats) || !pcoinsdbview->ReadTxOutSetHash(stats.hashBlock, txoutsethash))
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+            LOCK(cs_main);
+            pindex = mapBlockIndex.find(stats.hashBlock)->second;
+        }
+        ret.push_back(Pair("height", (int64_t)pindex->nHeight));
+        ret.push_back(Pair("bestblock", pindex->GetBlockHash().GetHex()));
+        ret.push_back(Pair("txouts", (int64_t)txoutsethash.nTransactionOutputs));
+        ret.push_back(Pair("bogosize", (int64_t)txoutsethash.nBogoSize));
+        ret.push_back(Pair("txoutset_hash", txoutsethash.GetHash().GetHex()));
+        ret.push_back(Pair("disk_size", pcoinsdbview->EstimateSize()));
+        ret.push_back(Pair("total_amount", ValueFromAmount(txoutsethash.nTotalAmount)));
+        return ret;
+    }
+    if (strHashType != "hash_serialized_2")
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown hash_type " + strHashType);
+    if (!request.params[1].isNull())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "height is only supported with txoutset_hash");
+
     CCoinsStats stats;
     FlushStateToDisk();
     if (GetUTXOStats(pcoinsdbview, stats)) {
@@ -937,6 +997,326 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the unspent transaction output set at the tip to a snapshot file,\n"
+            "from which a new node can start with -loadtxoutset.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The file to write, relative to the data directory unless absolute. It must not exist.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,       (numeric) The number of coins written\n"
+            "  \"base_hash\": \"hash\",     (string) The hash of the block the snapshot was taken at\n"
+            "  \"base_height\": n,         (numeric) The height of that block\n"
+            "  \"txoutset_hash\": \"hash\", (string) The hash committing to the coins, to pass with -assumeutxohash when loading\n"
+            "  \"path\": \"path\"           (string) The absolute path of the snapshot\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (fs::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    CTxOutSetSnapshotInfo info;
+    if (!DumpTxOutSet(path, info))
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to write the UTXO set snapshot, see debug.log");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_written", info.nCoins));
+    ret.push_back(Pair("base_hash", info.hashBlock.GetHex()));
+    ret.push_back(Pair("base_height", info.nHeight));
+    ret.push_back(Pair("txoutset_hash", info.hashCoins.GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+/** Number of entries the address index RPCs return per call by default */
+static const int DEFAULT_ADDRESS_QUERY_COUNT = 1000;
+
+static uint256 ParseAddressScriptHash(const UniValue& param)
+{
+    CBitcoinAddress address(param.get_str());
+    if (!address.IsValid())
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    return AddressIndex::GetScriptHash(GetScriptForDestination(address.Get()));
+}
+
+/** Let the address index catch up with the blocks already connected */
+static void WaitForAddressIndex()
+{
+    if (!g_addressindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index is not enabled. Use -addressindex");
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain())
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index is still being built");
+}
+
+static size_t ParseAddressQueryCount(const UniValue& param)
+{
+    int nCount = param.isNull() ? DEFAULT_ADDRESS_QUERY_COUNT : param.get_int();
+    if (nCount <= 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "count must be positive");
+    return nCount;
+}
+
+/** Cursors are the serialized position to continue at, in hex */
+template<typename Pos>
+static Pos ParseAddressCursor(const UniValue& param)
+{
+    Pos pos;
+    if (param.isNull())
+        return pos;
+    const std::string& strCursor = param.get_str();
+    if (!IsHex(strCursor))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    CDataStream ss(ParseHex(strCursor), SER_DISK, CLIENT_VERSION);
+    try {
+        ss >> pos;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    if (!ss.empty())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    return pos;
+}
+
+template<typename Pos>
+static UniValue EncodeAddressCursor(bool fMore, const Pos& pos)
+{
+    if (!fMore)
+        return NullUniValue;
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << pos;
+    return HexStr(ss.begin(), ss.end());
+}
+
+UniValue getaddresshistory(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3)
+        throw std::runtime_error(
+            "getaddresshistory \"address\" ( count \"cursor\" )\n"
+            "\nReturns the outputs an address received and spent in the block chain, oldest first.\n"
+            "Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. \"address\"    (string, required) The address\n"
+            "2. count        (numeric, optional, default=" + std::to_string(DEFAULT_ADDRESS_QUERY_COUNT) + ") The maximum number of entries to return\n"
+            "3. \"cursor\"     (string, optional) Continue at the \"next\" cursor of a previous call\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"history\": [\n"
+            "    {\n"
+            "      \"height\": n,        (numeric) The height of the block\n"
+            "      \"txid\": \"hash\",     (string) The transaction that created or spent the output\n"
+            "      \"index\": n,         (numeric) The output index, or the input index if spent\n"
+            "      \"amount\": x.xxx,    (numeric) The value of the output in " + CURRENCY_UNIT + "\n"
+            "      \"spent\": true|false (boolean) Whether the entry spends an output of the address\n"
+            "    }, ...\n"
+            "  ],\n"
+            "  \"next\": \"cursor\"     (string) The cursor for the next entries, or null if there are none\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddresshistory", "\"2bTFDy99MKi1R1fEL7CyPz3wBMvXyq9qSy\"")
+            + HelpExampleRpc("getaddresshistory", "\"2bTFDy99MKi1R1fEL7CyPz3wBMvXyq9qSy\", 100")
+        );
+
+    uint256 scripthash = ParseAddressScriptHash(request.params[0]);
+    size_t nCount = ParseAddressQueryCount(request.params[1]);
+    CAddressHistoryPos start = ParseAddressCursor<CAddressHistoryPos>(request.params[2]);
+    WaitForAddressIndex();
+
+    std::vector<CAddressHistoryEntry> entries;
+    bool fMore;
+    CAddressHistoryPos next;
+    if (!g_addressindex->FindHistory(scripthash, start, nCount, entries, fMore, next))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the address index");
+
+    UniValue history(UniValue::VARR);
+    for (const CAddressHistoryEntry& entry : entries) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("height", (int64_t)entry.pos.nHeight));
+        obj.push_back(Pair("txid", entry.txid.GetHex()));
+        obj.push_back(Pair("index", (int64_t)entry.pos.nIndex));
+        obj.push_back(Pair("amount", ValueFromAmount(entry.nValue)));
+        obj.push_back(Pair("spent", entry.pos.fSpent != 0));
+        history.push_back(obj);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("history", history));
+    ret.push_back(Pair("next", EncodeAddressCursor(fMore, next)));
+    return ret;
+}
+
+UniValue getaddressutxos(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3)
+        throw std::runtime_error(
+            "getaddressutxos \"address\" ( count \"cursor\" )\n"
+            "\nReturns the unspent outputs of an address in the block chain.\n"
+            "Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. \"address\"    (string, required) The address\n"
+            "2. count        (numeric, optional, default=" + std::to_string(DEFAULT_ADDRESS_QUERY_COUNT) + ") The maximum number of outputs to return\n"
+            "3. \"cursor\"     (string, optional) Continue at the \"next\" cursor of a previous call\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"utxos\": [\n"
+            "    {\n"
+            "      \"txid\": \"hash\",   (string) The transaction id\n"
+            "      \"vout\": n,        (numeric) The output index\n"
+            "      \"height\": n,      (numeric) The height of the block the output was created in\n"
+            "      \"amount\": x.xxx   (numeric) The value of the output in " + CURRENCY_UNIT + "\n"
+            "    }, ...\n"
+            "  ],\n"
+            "  \"next\": \"cursor\"   (string) The cursor for the next outputs, or null if there are none\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressutxos", "\"2bTFDy99MKi1R1fEL7CyPz3wBMvXyq9qSy\"")
+            + HelpExampleRpc("getaddressutxos", "\"2bTFDy99MKi1R1fEL7CyPz3wBMvXyq9qSy\", 100")
+        );
+
+    uint256 scripthash = ParseAddressScriptHash(request.params[0]);
+    size_t nCount = ParseAddressQueryCount(request.params[1]);
+    CAddressUnspentPos start = ParseAddressCursor<CAddressUnspentPos>(request.params[2]);
+    WaitForAddressIndex();
+
+    std::vector<CAddressUnspentEntry> entries;
+    bool fMore;
+    CAddressUnspentPos next;
+    if (!g_addressindex->FindUnspent(scripthash, start, nCount, entries, fMore, next))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the address index");
+
+    UniValue utxos(UniValue::VARR);
+    for (const CAddressUnspentEntry& entry : entries) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("txid", entry.pos.txid.GetHex()));
+        obj.push_back(Pair("vout", (int64_t)entry.pos.n));
+        obj.push_back(Pair("height", (int64_t)entry.nHeight));
+        obj.push_back(Pair("amount", ValueFromAmount(entry.nValue)));
+        utxos.push_back(obj);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("utxos", utxos));
+    ret.push_back(Pair("next", EncodeAddressCursor(fMore, next)));
+    return ret;
+}
+
+UniValue getaddressbalance(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "getaddressbalance \"address\"\n"
+            "\nReturns the balance of an address in the block chain.\n"
+            "Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. \"address\"    (string, required) The address\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\": x.xxx,   (numeric) The value of the unspent outputs of the address in " + CURRENCY_UNIT + "\n"
+            "  \"received\": x.xxx   (numeric) The value of all outputs the address ever received in " + CURRENCY_UNIT + "\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressbalance", "\"2bTFDy99MKi1R1fEL7CyPz3wBMvXyq9qSy\"")
+            + HelpExampleRpc("getaddressbalance", "\"2bTFDy99MKi1R1fEL7CyPz3wBMvXyq9qSy\"")
+        );
+
+    uint256 scripthash = ParseAddressScriptHash(request.params[0]);
+    WaitForAddressIndex();
+
+    CAddressBalance balance;
+    if (!g_addressindex->FindBalance(scripthash, balance))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the address index");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("balance", ValueFromAmount(balance.nBalance)));
+    ret.push_back(Pair("received", ValueFromAmount(balance.nReceived)));
+    return ret;
+}
+
+UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "getblockfilter \"blockhash\" ( \"filtertype\" )\n"
+            "\nReturns the BIP 157 content filter of a block.\n"
+            "Requires -blockfilterindex.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"    (string, required) The hash of the block\n"
+            "2. \"filtertype\"   (string, optional) The type name of the filter (default: basic)\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"hex\",   (string) the hex-encoded filter data\n"
+            "  \"header\" : \"hex\"    (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+
+    uint256 block_hash = uint256S(request.params[0].get_str());
+    std::string filtertype_name = "basic";
+    if (!request.params[1].isNull()) {
+        filtertype_name = request.params[1].get_str();
+    }
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(filtertype_name, filtertype)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+
+    BlockFilterIndex* index = g_blockfilterindex.get();
+    if (!index || index->GetFilterType() != filtertype) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + filtertype_name);
+    }
+
+    const CBlockIndex* block_index;
+    bool block_was_connected;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(block_hash);
+        if (it == mapBlockIndex.end()) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block_index = it->second;
+        block_was_connected = block_index->IsValid(BLOCK_VALID_SCRIPTS);
+    }
+
+    bool index_ready = index->BlockUntilSyncedToCurrentChain();
+
+    BlockFilter filter;
+    uint256 filter_header;
+    if (!index->LookupFilter(block_index, filter) ||
+        !index->LookupFilterHeader(block_index, filter_header)) {
+        int err_code;
+        std::string errmsg = "Filter not found.";
+
+        if (!block_was_connected) {
+            err_code = RPC_INVALID_ADDRESS_OR_KEY;
+            errmsg += " Block was not connected to active chain.";
+        } else if (!index_ready) {
+            err_code = RPC_MISC_ERROR;
+            errmsg += " Block filters are still in the process of being indexed.";
+        } else {
+            err_code = RPC_INTERNAL_ERROR;
+            errmsg += " This error is unexpected and indicates index corruption.";
+        }
+
+        throw JSONRPCError(err_code, errmsg);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+    ret.push_back(Pair("header", filter_header.GetHex()));
+    return ret;
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -1542,6 +1922,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbosity|verbose"} },
     { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         true,  {"blockhash","filtertype"} },
     { "blockchain",         "getchaintips",           &getchaintips,           true,  {} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true,  {"txid","verbose"} },
@@ -1550,7 +1931,11 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {"hash_type","height"} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true,  {"path"} },
+    { "blockchain",         "getaddresshistory",      &getaddresshistory,      true,  {"address","count","cursor"} },
+    { "blockchain",         "getaddressutxos",        &getaddressutxos,        true,  {"address","count","cursor"} },
+    { "blockchain",         "getaddressbalance",      &getaddressbalance,      true,  {"address"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        true,  {"height"} },
     { "blockchain",         "verifychain",            &verifychain,            true,  {"checklevel","nblocks"} },
 
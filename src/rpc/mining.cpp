@@ -26,6 +26,7 @@
 #include "validationinterface.h"
 #include "warnings.h"
 
+#include <algorithm>
 #include <memory>
 #include <stdint.h>
 
@@ -110,15 +111,19 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
     static const int nInnerLoopCount = 0x10000;
     int nHeightEnd = 0;
     int nHeight = 0;
+    int nHeightStart = 0;
 
     {   // Don't keep cs_main locked
         LOCK(cs_main);
         nHeight = chainActive.Height();
+        nHeightStart = nHeight;
         nHeightEnd = nHeight+nGenerate;
     }
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    int64_t nLastProgress = GetTimeMillis();
     unsigned int nExtraNonce = 0;
     UniValue blockHashes(UniValue::VARR);
-    while (nHeight < nHeightEnd)
+    while (nHeight < nHeightEnd && !ShutdownRequested())
     {
         std::unique_ptr<CBlockTemplate> pblocktemplate(BlockAssembler(Params()).CreateNewBlock(coinbaseScript->reserveScript));
         if (!pblocktemplate.get())
@@ -128,14 +133,9 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
             LOCK(cs_main);
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetPoWHash(), pblock->nBits, Params().GetConsensus())) {
-            ++pblock->nNonce;
-            --nMaxTries;
-        }
-        if (nMaxTries == 0) {
-            break;
-        }
-        if (pblock->nNonce == nInnerLoopCount) {
+        if (!SearchBlockNonce(pblock, nInnerLoopCount, nMaxTries, consensusParams)) {
+            if (nMaxTries == 0 || ShutdownRequested())
+                break;
             continue;
         }
         std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
@@ -149,6 +149,11 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
         {
             coinbaseScript->KeepScript();
         }
+
+        if (GetTimeMillis() - nLastProgress > 10000) {
+            LogPrintf("generate: %d of %d blocks generated\n", nHeight - nHeightStart, nGenerate);
+            nLastProgress = GetTimeMillis();
+        }
     }
     return blockHashes;
 }
@@ -751,7 +756,7 @@ UniValue submitblock(const JSONRPCRequest& request)
     }
 
     submitblock_StateCatcher sc(block.GetHash());
-    RegisterValidationInterface(&sc);
+    RegisterValidationInterface(&sc, "submitblock");
     bool fAccepted = ProcessNewBlock(Params(), blockptr, true, nullptr);
     UnregisterValidationInterface(&sc);
     if (fBlockPresent) {
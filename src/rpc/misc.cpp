@@ -7,6 +7,7 @@
 #include "chain.h"
 #include "clientversion.h"
 #include "core_io.h"
+#include "dbwrapper.h"
 #include "init.h"
 #include "validation.h"
 #include "httpserver.h"
@@ -17,6 +18,7 @@
 #include "timedata.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "validationinterface.h"
 #ifdef ENABLE_WALLET
 #include "wallet/rpcwallet.h"
 #include "wallet/wallet.h"
@@ -568,6 +570,129 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+UniValue getnotificationqueueinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getnotificationqueueinfo\n"
+            "Returns how far each subscriber to block and transaction notifications (such as the wallet,\n"
+            "ZMQ and the network code) is behind the node.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",        (string) The subscriber\n"
+            "    \"pending\": n,            (numeric) Notifications queued for it and not delivered yet\n"
+            "    \"delivered\": n,          (numeric) Notifications delivered since it subscribed\n"
+            "    \"lag\": x.xxx,            (numeric) Seconds the oldest pending notification has been waiting\n"
+            "    \"max_lag\": x.xxx,        (numeric) Longest a notification has waited before being delivered, in seconds\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getnotificationqueueinfo", "")
+            + HelpExampleRpc("getnotificationqueueinfo", "")
+        );
+
+    std::vector<CValidationInterfaceQueueStats> vStats;
+    GetMainSignals().GetQueueStats(vStats);
+
+    UniValue ret(UniValue::VARR);
+    for (const CValidationInterfaceQueueStats& stats : vStats) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", stats.strName));
+        obj.push_back(Pair("pending", (uint64_t)stats.nPending));
+        obj.push_back(Pair("delivered", stats.nDelivered));
+        obj.push_back(Pair("lag", stats.nLag * 0.000001));
+        obj.push_back(Pair("max_lag", stats.nMaxLag * 0.000001));
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
+UniValue getdbstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getdbstats\n"
+            "Returns the LevelDB settings and statistics of each open database.\n"
+            "The settings can be changed per database with the -db* startup options.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",            (string) The database, as used in the -db* options\n"
+            "    \"path\": \"xxxx\",            (string) Its location\n"
+            "    \"max_open_files\": n,        (numeric) Number of files LevelDB may keep open\n"
+            "    \"block_size\": n,            (numeric) Size of table blocks in bytes\n"
+            "    \"block_cache_size\": n,      (numeric) Capacity of the block cache in bytes\n"
+            "    \"write_buffer_size\": n,     (numeric) Size of the write buffer in bytes\n"
+            "    \"compression\": true|false,  (boolean) Whether table blocks are compressed, false when LevelDB was built without Snappy\n"
+            "    \"bloom_bits\": n,            (numeric) Bits per key of the bloom filters, 0 if disabled\n"
+            "    \"block_cache_usage\": n,     (numeric) Bytes held by the block cache\n"
+            "    \"block_cache_hits\": n,      (numeric) Block lookups served from the cache\n"
+            "    \"block_cache_misses\": n,    (numeric) Block lookups that had to read a table file\n"
+            "    \"block_cache_hit_rate\": x.xxx, (numeric) Share of block lookups served from the cache\n"
+            "    \"memory_usage\": n,          (numeric) Approximate bytes used by the block cache and the memtables\n"
+            "    \"memtable_stalls\": n,       (numeric) Writes that waited for a full memtable to be written out\n"
+            "    \"level0_stalls\": n,         (numeric) Writes that waited because level 0 had too many files\n"
+            "    \"compaction_time\": x.xxx,   (numeric) Seconds spent in compactions\n"
+            "    \"levels\": [                 (json array) The non-empty levels\n"
+            "      {\n"
+            "        \"level\": n,             (numeric) The level\n"
+            "        \"files\": n,             (numeric) Number of table files\n"
+            "        \"size\": x.xxx,          (numeric) Size of the files in MiB\n"
+            "        \"compaction_time\": x.xxx, (numeric) Seconds spent in compactions into this level\n"
+            "        \"compaction_read\": x.xxx, (numeric) MiB read by those compactions\n"
+            "        \"compaction_written\": x.xxx, (numeric) MiB written by those compactions\n"
+            "      },\n"
+            "      ...\n"
+            "    ]\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbstats", "")
+            + HelpExampleRpc("getdbstats", "")
+        );
+
+    UniValue ret(UniValue::VARR);
+    for (const CDBStats& stats : GetAllDBStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", stats.strName));
+        obj.push_back(Pair("path", stats.strPath));
+        obj.push_back(Pair("max_open_files", stats.nMaxOpenFiles));
+        obj.push_back(Pair("block_size", (uint64_t)stats.nBlockSize));
+        obj.push_back(Pair("block_cache_size", (uint64_t)stats.nBlockCacheSize));
+        obj.push_back(Pair("write_buffer_size", (uint64_t)stats.nWriteBufferSize));
+        obj.push_back(Pair("compression", stats.fCompression));
+        obj.push_back(Pair("bloom_bits", stats.nBloomBits));
+        obj.push_back(Pair("block_cache_usage", (uint64_t)stats.nBlockCacheUsage));
+        obj.push_back(Pair("block_cache_hits", stats.nBlockCacheHits));
+        obj.push_back(Pair("block_cache_misses", stats.nBlockCacheMisses));
+        uint64_t nLookups = stats.nBlockCacheHits + stats.nBlockCacheMisses;
+        obj.push_back(Pair("block_cache_hit_rate", nLookups ? (double)stats.nBlockCacheHits / nLookups : 0.0));
+        obj.push_back(Pair("memory_usage", stats.nMemoryUsage));
+        obj.push_back(Pair("memtable_stalls", stats.nMemtableStalls));
+        obj.push_back(Pair("level0_stalls", stats.nLevel0Stalls));
+        double dCompactionTime = 0;
+        UniValue levels(UniValue::VARR);
+        for (const CDBStats::Level& level : stats.vLevels) {
+            UniValue levelobj(UniValue::VOBJ);
+            levelobj.push_back(Pair("level", level.nLevel));
+            levelobj.push_back(Pair("files", level.nFiles));
+            levelobj.push_back(Pair("size", level.dSizeMB));
+            levelobj.push_back(Pair("compaction_time", level.dCompactionSeconds));
+            levelobj.push_back(Pair("compaction_read", level.dReadMB));
+            levelobj.push_back(Pair("compaction_written", level.dWrittenMB));
+            levels.push_back(levelobj);
+            dCompactionTime += level.dCompactionSeconds;
+        }
+        obj.push_back(Pair("compaction_time", dCompactionTime));
+        obj.push_back(Pair("levels", levels));
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
 uint32_t getCategoryMask(UniValue cats) {
     cats = cats.get_array();
     uint32_t mask = 0;
@@ -653,6 +778,8 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {"mode"} },
+    { "control",            "getnotificationqueueinfo", &getnotificationqueueinfo, true, {} },
+    { "control",            "getdbstats",             &getdbstats,             true,  {} },
     { "util",               "validateaddress",        &validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          true,  {"address","signature","message"} },
@@ -6,7 +6,9 @@
 
 #include "random.h"
 #include "reverselock.h"
+#include "utiltime.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <boost/bind.hpp>
 #include <utility>
@@ -155,19 +157,15 @@ void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue() {
         if (m_are_callbacks_running) return;
         if (m_callbacks_pending.empty()) return;
     }
-    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this));
+    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, shared_from_this()));
 }
 
 void SingleThreadedSchedulerClient::ProcessQueue() {
-    std::function<void (void)> callback;
     {
         LOCK(m_cs_callbacks_pending);
         if (m_are_callbacks_running) return;
         if (m_callbacks_pending.empty()) return;
         m_are_callbacks_running = true;
-
-        callback = std::move(m_callbacks_pending.front());
-        m_callbacks_pending.pop_front();
     }
 
     // RAII the setting of fCallbacksRunning and calling MaybeScheduleProcessQueue
@@ -179,12 +177,29 @@ void SingleThreadedSchedulerClient::ProcessQueue() {
             {
                 LOCK(instance->m_cs_callbacks_pending);
                 instance->m_are_callbacks_running = false;
+                instance->m_running_since = 0;
             }
             instance->MaybeScheduleProcessQueue();
         }
     } raiicallbacksrunning(this);
 
-    callback();
+    for (size_t i = 0; i < MAX_JOBS_PER_BATCH; i++) {
+        std::function<void (void)> callback;
+        {
+            LOCK(m_cs_callbacks_pending);
+            if (m_callbacks_pending.empty()) break;
+            m_running_since = m_callbacks_pending.front().first;
+            m_max_lag = std::max(m_max_lag, GetTimeMicros() - m_running_since);
+            callback = std::move(m_callbacks_pending.front().second);
+            m_callbacks_pending.pop_front();
+        }
+
+        callback();
+
+        LOCK(m_cs_callbacks_pending);
+        m_running_since = 0;
+        m_callbacks_processed++;
+    }
 }
 
 void SingleThreadedSchedulerClient::AddToProcessQueue(std::function<void (void)> func) {
@@ -192,7 +207,7 @@ void SingleThreadedSchedulerClient::AddToProcessQueue(std::function<void (void)>
 
     {
         LOCK(m_cs_callbacks_pending);
-        m_callbacks_pending.emplace_back(std::move(func));
+        m_callbacks_pending.emplace_back(GetTimeMicros(), std::move(func));
     }
     MaybeScheduleProcessQueue();
 }
@@ -206,3 +221,26 @@ void SingleThreadedSchedulerClient::EmptyQueue() {
         should_continue = !m_callbacks_pending.empty();
     }
 }
+
+void SingleThreadedSchedulerClient::ClearQueue() {
+    LOCK(m_cs_callbacks_pending);
+    m_callbacks_pending.clear();
+}
+
+size_t SingleThreadedSchedulerClient::CallbacksPending() {
+    LOCK(m_cs_callbacks_pending);
+    return m_callbacks_pending.size() + (m_running_since ? 1 : 0);
+}
+
+void SingleThreadedSchedulerClient::GetStats(Stats& stats) {
+    LOCK(m_cs_callbacks_pending);
+    stats.nPending = m_callbacks_pending.size() + (m_running_since ? 1 : 0);
+    stats.nProcessed = m_callbacks_processed;
+    stats.nLag = 0;
+    if (m_running_since) {
+        stats.nLag = GetTimeMicros() - m_running_since;
+    } else if (!m_callbacks_pending.empty()) {
+        stats.nLag = GetTimeMicros() - m_callbacks_pending.front().first;
+    }
+    stats.nMaxLag = m_max_lag;
+}
@@ -12,10 +12,17 @@
 //
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
+#include <list>
 #include <map>
+#include <memory>
 
 #include "sync.h"
 
+/** Default number of threads servicing the scheduler started by init */
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+/** Maximum number of threads servicing the scheduler started by init */
+static const int MAX_SCHEDULER_THREADS = 16;
+
 //
 // Simple class for background tasks that should be run
 // periodically or once "after a while"
@@ -89,14 +96,40 @@ private:
  * which are required to be run serially. Does not require such jobs
  * to be executed on the same thread, but no two jobs will be executed
  * at the same time.
+ *
+ * Queued jobs are run in batches of up to MAX_JOBS_PER_BATCH per scheduler
+ * task, so a busy client does not pay for a task per job, but does not hold
+ * on to a scheduler thread forever either. Every scheduled task keeps the
+ * client alive, so instances must be owned by a std::shared_ptr.
  */
-class SingleThreadedSchedulerClient {
+class SingleThreadedSchedulerClient : public std::enable_shared_from_this<SingleThreadedSchedulerClient> {
+public:
+    //! Most queued jobs one scheduler task runs before making way for other tasks
+    static const size_t MAX_JOBS_PER_BATCH = 64;
+
+    struct Stats
+    {
+        //! Jobs queued or running
+        size_t nPending;
+        //! Jobs run so far
+        uint64_t nProcessed;
+        //! Microseconds the oldest pending job has been waiting, or 0 if there is none
+        int64_t nLag;
+        //! Longest a job has waited between being queued and being run, in microseconds
+        int64_t nMaxLag;
+    };
+
 private:
     CScheduler *m_pscheduler;
 
     CCriticalSection m_cs_callbacks_pending;
-    std::list<std::function<void (void)>> m_callbacks_pending;
+    //! Queued jobs, with the time (in microseconds) they were queued
+    std::list<std::pair<int64_t, std::function<void (void)>>> m_callbacks_pending;
     bool m_are_callbacks_running = false;
+    //! Queue time of the job that is currently running, or 0 between jobs
+    int64_t m_running_since = 0;
+    uint64_t m_callbacks_processed = 0;
+    int64_t m_max_lag = 0;
 
     void MaybeScheduleProcessQueue();
     void ProcessQueue();
@@ -108,6 +141,14 @@ public:
     // Processes all remaining queue members on the calling thread, blocking until queue is empty
     // Must be called after the CScheduler has no remaining processing threads!
     void EmptyQueue();
+
+    // Drops the jobs that have not started yet
+    void ClearQueue();
+
+    // Returns the number of jobs queued or running
+    size_t CallbacksPending();
+
+    void GetStats(Stats& stats);
 };
 
 #endif
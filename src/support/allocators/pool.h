@@ -0,0 +1,202 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Memory resource that carves small blocks out of larger chunks.
+ *
+ * Blocks are rounded up to a multiple of ALIGN_BYTES. A freed block goes to
+ * the free list of its size and is handed out again by the next allocation of
+ * that size; chunks are only returned to the system when the resource is
+ * destroyed. Requests larger than MAX_BLOCK_SIZE_BYTES (or with a stricter
+ * alignment) are passed on to operator new. Chunks start small and grow, so
+ * that short-lived containers holding a few elements stay cheap.
+ *
+ * Not thread safe.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    static_assert(ALIGN_BYTES >= sizeof(void*), "blocks must be able to hold a free list pointer");
+    static_assert((ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "alignment must be a power of two");
+    static_assert(ALIGN_BYTES <= alignof(std::max_align_t), "chunks are only aligned to std::max_align_t");
+
+    static const std::size_t NUM_SIZES = (MAX_BLOCK_SIZE_BYTES + ALIGN_BYTES - 1) / ALIGN_BYTES;
+    static const std::size_t MIN_CHUNK_SIZE_BYTES = 16 << 10;
+    static const std::size_t MAX_CHUNK_SIZE_BYTES = 256 << 10;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    //! Free lists; index i holds blocks of (i + 1) * ALIGN_BYTES bytes.
+    std::array<FreeBlock*, NUM_SIZES> vFree;
+    std::vector<std::pair<void*, std::size_t> > vChunks;
+    char* pChunkPos;
+    char* pChunkEnd;
+    std::size_t nNextChunkSize;
+    std::size_t nChunkBytes;
+    std::size_t nLargeBytes;
+
+    static std::size_t SizeIndex(std::size_t bytes)
+    {
+        return (std::max<std::size_t>(bytes, 1) + ALIGN_BYTES - 1) / ALIGN_BYTES - 1;
+    }
+
+    static bool IsPooled(std::size_t bytes, std::size_t alignment)
+    {
+        return bytes <= MAX_BLOCK_SIZE_BYTES && alignment <= ALIGN_BYTES;
+    }
+
+    void PushFree(void* p, std::size_t index)
+    {
+        FreeBlock* block = static_cast<FreeBlock*>(p);
+        block->next = vFree[index];
+        vFree[index] = block;
+    }
+
+    void NewChunk()
+    {
+        // The unused tail of the current chunk is a multiple of ALIGN_BYTES
+        // and smaller than any block size, so it fits one of the free lists.
+        const std::size_t nTail = pChunkEnd - pChunkPos;
+        if (nTail >= ALIGN_BYTES)
+            PushFree(pChunkPos, nTail / ALIGN_BYTES - 1);
+        void* chunk = ::operator new(nNextChunkSize);
+        vChunks.emplace_back(chunk, nNextChunkSize);
+        nChunkBytes += nNextChunkSize;
+        pChunkPos = static_cast<char*>(chunk);
+        pChunkEnd = pChunkPos + nNextChunkSize;
+        nNextChunkSize = std::min(nNextChunkSize * 2, MAX_CHUNK_SIZE_BYTES);
+    }
+
+public:
+    PoolResource() : pChunkPos(nullptr), pChunkEnd(nullptr), nNextChunkSize(MIN_CHUNK_SIZE_BYTES), nChunkBytes(0), nLargeBytes(0)
+    {
+        vFree.fill(nullptr);
+    }
+
+    ~PoolResource()
+    {
+        for (const auto& chunk : vChunks)
+            ::operator delete(chunk.first);
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsPooled(bytes, alignment)) {
+            nLargeBytes += bytes;
+            return ::operator new(bytes);
+        }
+        const std::size_t index = SizeIndex(bytes);
+        if (vFree[index] != nullptr) {
+            FreeBlock* block = vFree[index];
+            vFree[index] = block->next;
+            return block;
+        }
+        const std::size_t nBlockSize = (index + 1) * ALIGN_BYTES;
+        if ((std::size_t)(pChunkEnd - pChunkPos) < nBlockSize)
+            NewChunk();
+        void* p = pChunkPos;
+        pChunkPos += nBlockSize;
+        return p;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsPooled(bytes, alignment)) {
+            nLargeBytes -= bytes;
+            ::operator delete(p);
+            return;
+        }
+        PushFree(p, SizeIndex(bytes));
+    }
+
+    //! Bytes obtained from the system: all chunks, plus the live allocations that bypassed them.
+    std::size_t MemoryUsage() const { return nChunkBytes + nLargeBytes; }
+};
+
+/**
+ * Allocator for node-based containers that takes its memory from a
+ * PoolResource, which saves the per-allocation overhead of malloc and keeps
+ * the nodes close together. Copies of an allocator (including the rebound
+ * ones a container makes internally) share one resource, which lives as long
+ * as any of them. A default-constructed allocator creates a new resource.
+ *
+ * MAX_BLOCK_SIZE_BYTES should be at least the node size of the container, or
+ * the nodes will bypass the pool.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(void*)>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> Resource;
+
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <class U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    PoolAllocator() : resource(std::make_shared<Resource>()) {}
+
+    // There is deliberately no move constructor: a moved-from container must
+    // keep a usable allocator.
+    PoolAllocator(const PoolAllocator& other) noexcept : resource(other.resource) {}
+
+    template <class U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : resource(other.GetResource()) {}
+
+    PoolAllocator& operator=(const PoolAllocator& other) noexcept
+    {
+        resource = other.resource;
+        return *this;
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    const std::shared_ptr<Resource>& GetResource() const { return resource; }
+
+private:
+    std::shared_ptr<Resource> resource;
+};
+
+template <class T, class U, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b)
+{
+    return a.GetResource() == b.GetResource();
+}
+
+template <class T, class U, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b)
+{
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
@@ -4,6 +4,9 @@
 
 #include "util.h"
 
+#include "prevector.h" // memusage.h is not self-contained
+#include "memusage.h"
+#include "support/allocators/pool.h"
 #include "support/allocators/secure.h"
 #include "test/test_bitcoin.h"
 
@@ -231,4 +234,40 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(pool_allocator_tests)
+{
+    typedef PoolAllocator<std::pair<const int, int>, 64> Allocator;
+    typedef std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, Allocator> Map;
+
+    Map map;
+    const size_t initial = memusage::DynamicUsage(map);
+    for (int i = 0; i < 10000; i++)
+        map.emplace(i, i);
+    const size_t filled = memusage::DynamicUsage(map);
+    BOOST_CHECK(filled > initial);
+
+    // Freed nodes are reused, so refilling the map takes no more memory.
+    for (int i = 0; i < 10000; i++)
+        map.erase(i);
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), filled);
+    for (int i = 0; i < 10000; i++)
+        map.emplace(i + 10000, i);
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), filled);
+
+    // A map constructed from another shares its pool; a new map has its own.
+    Map moved(std::move(map));
+    BOOST_CHECK(moved.get_allocator() == map.get_allocator());
+    BOOST_CHECK_EQUAL(moved.size(), 10000U);
+    map.clear();
+    map.emplace(1, 1);
+    BOOST_CHECK(Map().get_allocator() != moved.get_allocator());
+
+    // Allocations larger than a block bypass the pool but are accounted for.
+    Allocator::Resource resource;
+    void* p = resource.Allocate(1000, 8);
+    BOOST_CHECK_EQUAL(resource.MemoryUsage(), 1000U);
+    resource.Deallocate(p, 1000, 8);
+    BOOST_CHECK_EQUAL(resource.MemoryUsage(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
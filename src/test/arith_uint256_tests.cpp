@@ -10,6 +10,7 @@
 #include <cmath>
 #include "uint256.h"
 #include "arith_uint256.h"
+#include "pow.h"
 #include <string>
 #include "version.h"
 #include "test/test_bitcoin.h"
@@ -368,6 +369,22 @@ BOOST_AUTO_TEST_CASE( divide )
     BOOST_CHECK_THROW(R2L / ZeroL, uint_error);
 }
 
+BOOST_AUTO_TEST_CASE( divide_small ) // DivideSmall must match "/" exactly, it is used in the retargets
+{
+    const uint32_t divisors[] = {1, 2, 3, 25, 0xffff, 0x10000, 0xfffffffe, 0xffffffff};
+    const arith_uint256 values[] = {ZeroL, OneL, R1L, R2L, HalfL, HalfL - 1, MaxL, MaxL - 1, MaxL >> 32, (MaxL >> 32) + 1};
+    for (uint32_t b : divisors) {
+        for (const arith_uint256& a : values) {
+            BOOST_CHECK(DivideSmall(a, b) == a / b);
+        }
+    }
+    for (int i = 0; i < 1000; i++) {
+        const arith_uint256 a = UintToArith256(InsecureRand256()) >> InsecureRandRange(256);
+        const uint32_t b = std::max<uint32_t>(1, InsecureRand32() >> InsecureRandRange(32));
+        BOOST_CHECK(DivideSmall(a, b) == a / b);
+    }
+}
+
 
 bool almostEqual(double d1, double d2)
 {
@@ -0,0 +1,124 @@
+// Copyright (c) 2018 The Litebitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "coins.h"
+#include "fs.h"
+#include "pow.h"
+#include "script/script.h"
+#include "streams.h"
+#include "undo.h"
+#include "validation.h"
+#include "version.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+struct BlockFileSetup : public TestingSetup {
+    const int nBlockFileMapsSaved;
+    BlockFileSetup() : TestingSetup(CBaseChainParams::REGTEST), nBlockFileMapsSaved(nBlockFileMaps) {}
+    ~BlockFileSetup() {
+        nBlockFileMaps = nBlockFileMapsSaved;
+    }
+};
+
+/** A file number the chain in the test data directory does not use */
+static const int TEST_FILE = 99;
+
+static uint64_t FileSize(const char* prefix)
+{
+    const fs::path path = GetBlockPosFilename(CDiskBlockPos(TEST_FILE, 0), prefix);
+    return fs::exists(path) ? fs::file_size(path) : 0;
+}
+
+/** Append a block record to the test block file, as WriteBlockToDisk does */
+static CDiskBlockPos AppendBlock(const CBlock& block)
+{
+    CDiskBlockPos pos(TEST_FILE, FileSize("blk"));
+    CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!fileout.IsNull());
+    unsigned int nSize = GetSerializeSize(fileout, block);
+    fileout << FLATDATA(Params().MessageStart()) << nSize;
+    pos.nPos = ftell(fileout.Get());
+    fileout << block;
+    return pos;
+}
+
+static CDiskBlockPos AppendUndo(const CBlockUndo& blockundo, const uint256& hashBlock)
+{
+    CDiskBlockPos pos(TEST_FILE, FileSize("rev"));
+    BOOST_REQUIRE(UndoWriteToDisk(blockundo, pos, hashBlock, Params().MessageStart()));
+    return pos;
+}
+
+static CBlockUndo MakeUndo(CAmount nValue)
+{
+    CBlockUndo blockundo;
+    blockundo.vtxundo.emplace_back();
+    blockundo.vtxundo.back().vprevout.emplace_back(CTxOut(nValue, CScript() << OP_TRUE), 1, false);
+    return blockundo;
+}
+
+static std::string Serialized(const CBlockUndo& blockundo)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << blockundo;
+    return ss.str();
+}
+
+BOOST_FIXTURE_TEST_SUITE(blockfile_tests, BlockFileSetup)
+
+BOOST_AUTO_TEST_CASE(mapped_roundtrip)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    nBlockFileMaps = 4;
+
+    const CBlock& blockA = Params().GenesisBlock();
+    CBlock blockB = blockA;
+    blockB.nTime++;
+    while (!CheckProofOfWork(blockB.GetPoWHash(), blockB.nBits, consensusParams))
+        ++blockB.nNonce;
+    const CBlockUndo undoA = MakeUndo(500);
+    const CBlockUndo undoB = MakeUndo(600);
+
+    // Read back through a fresh mapping of each file
+    CBlock block;
+    CBlockUndo blockundo;
+    const CDiskBlockPos posA = AppendBlock(blockA);
+    const CDiskBlockPos posUndoA = AppendUndo(undoA, blockA.GetHash());
+    BOOST_CHECK(ReadBlockFromDisk(block, posA, consensusParams));
+    BOOST_CHECK(block.GetHash() == blockA.GetHash());
+    BOOST_CHECK(UndoReadFromDisk(blockundo, posUndoA, blockA.GetHash()));
+    BOOST_CHECK(Serialized(blockundo) == Serialized(undoA));
+    BOOST_CHECK(!UndoReadFromDisk(blockundo, posUndoA, blockB.GetHash()));
+
+    // Records appended after the files were mapped are found by mapping them again
+    const CDiskBlockPos posB = AppendBlock(blockB);
+    const CDiskBlockPos posUndoB = AppendUndo(undoB, blockB.GetHash());
+    BOOST_CHECK(ReadBlockFromDisk(block, posB, consensusParams));
+    BOOST_CHECK(block.GetHash() == blockB.GetHash());
+    BOOST_CHECK(UndoReadFromDisk(blockundo, posUndoB, blockB.GetHash()));
+    BOOST_CHECK(Serialized(blockundo) == Serialized(undoB));
+
+    // Once mapped, the records are read from the mapping and not from the
+    // files, which is only visible after the files are gone
+    fs::remove(GetBlockPosFilename(posA, "blk"));
+    fs::remove(GetBlockPosFilename(posUndoA, "rev"));
+    BOOST_CHECK(ReadBlockFromDisk(block, posA, consensusParams));
+    BOOST_CHECK(block.GetHash() == blockA.GetHash());
+    BOOST_CHECK(ReadBlockFromDisk(block, posB, consensusParams));
+    BOOST_CHECK(block.GetHash() == blockB.GetHash());
+    BOOST_CHECK(UndoReadFromDisk(blockundo, posUndoA, blockA.GetHash()));
+    BOOST_CHECK(Serialized(blockundo) == Serialized(undoA));
+    BOOST_CHECK(UndoReadFromDisk(blockundo, posUndoB, blockB.GetHash()));
+    BOOST_CHECK(Serialized(blockundo) == Serialized(undoB));
+
+    // while reading with stdio needs them
+    nBlockFileMaps = 0;
+    BOOST_CHECK(!ReadBlockFromDisk(block, posA, consensusParams));
+    BOOST_CHECK(!UndoReadFromDisk(blockundo, posUndoA, blockA.GetHash()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
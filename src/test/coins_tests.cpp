@@ -4,6 +4,7 @@
 
 #include "coins.h"
 #include "script/standard.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "undo.h"
 #include "utilstrencodings.h"
@@ -656,6 +657,42 @@ BOOST_AUTO_TEST_CASE(ccoins_access)
     CheckAccessCoin(VALUE1, VALUE2, VALUE2, DIRTY|FRESH, DIRTY|FRESH);
 }
 
+void CheckFetchedCoin(CAmount base_value, CAmount cache_value, CAmount expected_value, char cache_flags, char expected_flags)
+{
+    SingleEntryCacheTest test(base_value, cache_value, cache_flags);
+    Coin coin;
+    if (test.cache.GetCoinFromBase(OUTPOINT, coin))
+        test.cache.AddFetchedCoin(OUTPOINT, std::move(coin));
+    test.cache.SelfTest();
+
+    CAmount result_value;
+    char result_flags;
+    GetCoinsMapEntry(test.cache.map(), result_value, result_flags);
+    BOOST_CHECK_EQUAL(result_value, expected_value);
+    BOOST_CHECK_EQUAL(result_flags, expected_flags);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_fetched)
+{
+    /* Check that reading a coin with GetCoinFromBase and adding it with
+     * AddFetchedCoin, as the coins prefetch does, leaves the same cache entry
+     * as AccessCoin.
+     *
+     *                Base    Cache   Result  Cache        Result
+     *                Value   Value   Value   Flags        Flags
+     */
+    CheckFetchedCoin(ABSENT, ABSENT, ABSENT, NO_ENTRY   , NO_ENTRY   );
+    CheckFetchedCoin(ABSENT, PRUNED, PRUNED, DIRTY      , DIRTY      );
+    CheckFetchedCoin(ABSENT, VALUE2, VALUE2, DIRTY|FRESH, DIRTY|FRESH);
+    CheckFetchedCoin(PRUNED, ABSENT, ABSENT, NO_ENTRY   , NO_ENTRY   );
+    CheckFetchedCoin(PRUNED, PRUNED, PRUNED, FRESH      , FRESH      );
+    CheckFetchedCoin(VALUE1, ABSENT, VALUE1, NO_ENTRY   , 0          );
+    CheckFetchedCoin(VALUE1, PRUNED, PRUNED, 0          , 0          );
+    CheckFetchedCoin(VALUE1, PRUNED, PRUNED, DIRTY      , DIRTY      );
+    CheckFetchedCoin(VALUE1, VALUE2, VALUE2, 0          , 0          );
+    CheckFetchedCoin(VALUE1, VALUE2, VALUE2, DIRTY|FRESH, DIRTY|FRESH);
+}
+
 void CheckSpendCoins(CAmount base_value, CAmount cache_value, CAmount expected_value, char cache_flags, char expected_flags)
 {
     SingleEntryCacheTest test(base_value, cache_value, cache_flags);
@@ -855,4 +892,93 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_FIXTURE_TEST_CASE(coins_db_background_flush, TestingSetup)
+{
+    CCoinsViewDB db(1 << 20, true, false, true);
+    CCoinsViewCache cache(&db);
+    const COutPoint outpoint1(InsecureRand256(), 0);
+    const COutPoint outpoint2(InsecureRand256(), 1);
+    const uint256 hashBlock1 = InsecureRand256();
+    const uint256 hashBlock2 = InsecureRand256();
+    Coin coin;
+    coin.out.nValue = 100;
+    coin.nHeight = 1;
+
+    cache.AddCoin(outpoint1, Coin(coin), false);
+    cache.SetBestBlock(hashBlock1);
+    BOOST_CHECK(cache.Flush());
+    // The entries are visible as soon as BatchWrite returns.
+    BOOST_CHECK(db.HaveCoin(outpoint1));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock1);
+
+    // Spend the coin while it may still be being written, then flush again.
+    BOOST_CHECK(cache.SpendCoin(outpoint1));
+    cache.AddCoin(outpoint2, Coin(coin), false);
+    cache.SetBestBlock(hashBlock2);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!db.HaveCoin(outpoint1));
+    BOOST_CHECK(db.HaveCoin(outpoint2));
+
+    BOOST_CHECK(db.Sync());
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+    BOOST_CHECK(!db.GetCoin(outpoint1, coin));
+    BOOST_CHECK(db.GetCoin(outpoint2, coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 100);
+
+    std::unique_ptr<CCoinsViewCursor> pcursor(db.Cursor());
+    BOOST_CHECK(pcursor->GetBestBlock() == hashBlock2);
+    int nCoins = 0;
+    for (; pcursor->Valid(); pcursor->Next())
+        nCoins++;
+    BOOST_CHECK_EQUAL(nCoins, 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_db_getcoins, TestingSetup)
+{
+    for (bool fBackgroundFlush : {false, true}) {
+        CCoinsViewDB db(1 << 20, true, true, fBackgroundFlush);
+        CCoinsViewCache cache(&db);
+        std::vector<COutPoint> outpoints;
+        for (int i = 0; i < 20; i++) {
+            Coin coin;
+            coin.out.nValue = InsecureRandRange(1000) + 1;
+            coin.out.scriptPubKey.assign(InsecureRandRange(100), 0);
+            coin.nHeight = i;
+            outpoints.emplace_back(InsecureRand256(), i);
+            cache.AddCoin(outpoints.back(), std::move(coin), false);
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+        // Spend some, leaving them pending in the background flush if there is one
+        for (int i = 0; i < 20; i += 5)
+            BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+        for (int i = 0; i < 5; i++)
+            outpoints.emplace_back(InsecureRand256(), 0);
+        std::random_shuffle(outpoints.begin(), outpoints.end(), [](int n) { return InsecureRandRange(n); });
+
+        std::vector<Coin> coins;
+        std::vector<bool> found;
+        BOOST_CHECK_EQUAL(db.GetCoins(outpoints, coins, found), 16);
+        BOOST_REQUIRE_EQUAL(coins.size(), outpoints.size());
+        for (size_t i = 0; i < outpoints.size(); i++) {
+            Coin coin;
+            BOOST_CHECK_EQUAL(found[i], db.GetCoin(outpoints[i], coin));
+            if (found[i]) {
+                BOOST_CHECK(coins[i].out == coin.out);
+                BOOST_CHECK_EQUAL(coins[i].nHeight, coin.nHeight);
+            }
+        }
+
+        // The default implementation answers the same through GetCoin
+        CCoinsViewBacked backed(&db);
+        std::vector<bool> found_backed;
+        BOOST_CHECK_EQUAL(backed.GetCoins(outpoints, coins, found_backed), 16);
+        BOOST_CHECK(found_backed == found);
+        BOOST_CHECK(db.Sync());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,8 @@
 #include "random.h"
 #include "test/test_bitcoin.h"
 
+#include <map>
+
 #include <boost/test/unit_test.hpp>
 
 // Test if a string consists entirely of null characters
@@ -77,6 +79,56 @@ BOOST_AUTO_TEST_CASE(dbwrapper_batch)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_multiread)
+{
+    // Perform tests both obfuscated and non-obfuscated.
+    for (bool obfuscate : {false, true}) {
+        fs::path ph = fs::temp_directory_path() / fs::unique_path();
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+
+        // Values of odd lengths are read in pieces that do not line up with
+        // the obfuscation key; keys longer than DBWRAPPER_PREALLOC_KEY_SIZE
+        // are written to the heap.
+        std::vector<std::string> keys;
+        std::map<std::string, std::vector<unsigned char>> values;
+        for (int i = 0; i < 50; i++) {
+            std::string key = std::string(1 + InsecureRandRange(100), 'k') + std::to_string(i);
+            std::vector<unsigned char> value(InsecureRandRange(300));
+            for (unsigned char& c : value)
+                c = InsecureRandBits(8);
+            BOOST_CHECK(dbw.Write(key, value));
+            keys.push_back(key);
+            values[key] = value;
+        }
+        std::random_shuffle(keys.begin(), keys.end(), [](int n) { return InsecureRandRange(n); });
+        keys.insert(keys.begin() + 10, "missing");
+        keys.push_back("also missing");
+
+        std::vector<std::vector<unsigned char>> res;
+        std::vector<bool> found;
+        BOOST_CHECK_EQUAL(dbw.MultiRead(keys, res, found), 50);
+        BOOST_REQUIRE_EQUAL(res.size(), keys.size());
+        BOOST_REQUIRE_EQUAL(found.size(), keys.size());
+        for (size_t i = 0; i < keys.size(); i++) {
+            std::vector<unsigned char> value;
+            BOOST_CHECK_EQUAL(found[i], dbw.Read(keys[i], value));
+            if (found[i]) {
+                BOOST_CHECK(res[i] == values[keys[i]]);
+                BOOST_CHECK(value == values[keys[i]]);
+            }
+        }
+
+        // A value that does not deserialize as the requested type is not found
+        std::vector<uint256> bad_res;
+        BOOST_CHECK(dbw.Write(std::string("short"), (uint16_t)1));
+        BOOST_CHECK_EQUAL(dbw.MultiRead(std::vector<std::string>{"short"}, bad_res, found), 0);
+        BOOST_CHECK(!found[0]);
+
+        BOOST_CHECK_EQUAL(dbw.MultiRead(std::vector<std::string>(), res, found), 0);
+        BOOST_CHECK(res.empty() && found.empty());
+    }
+}
+
 BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 {
     // Perform tests both obfuscated and non-obfuscated.
@@ -317,6 +369,75 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_parse_arg)
+{
+    std::string name;
+    int64_t value;
+    BOOST_CHECK(ParseDBArg("100", name, value));
+    BOOST_CHECK_EQUAL(name, "");
+    BOOST_CHECK_EQUAL(value, 100);
+    BOOST_CHECK(ParseDBArg("chainstate:1000", name, value));
+    BOOST_CHECK_EQUAL(name, "chainstate");
+    BOOST_CHECK_EQUAL(value, 1000);
+    BOOST_CHECK(ParseDBArg("", name, value));
+    BOOST_CHECK_EQUAL(name, "");
+    BOOST_CHECK_EQUAL(value, 1);
+    BOOST_CHECK(ParseDBArg("txindex:", name, value));
+    BOOST_CHECK_EQUAL(name, "txindex");
+    BOOST_CHECK_EQUAL(value, 1);
+    BOOST_CHECK(!ParseDBArg("-1", name, value));
+    BOOST_CHECK(!ParseDBArg("chainstate:x", name, value));
+    BOOST_CHECK(!ParseDBArg("chainstate", name, value));
+}
+
+BOOST_AUTO_TEST_CASE(dbwrapper_options_and_stats)
+{
+    // A setting for all databases, one for this database and one for another
+    gArgs.ForceSetArg("-dbmaxopenfiles", "100");
+    gArgs.ForceSetArg("-dbbloombits", "dbtest:0");
+    gArgs.ForceSetArg("-dbblocksize", "otherdb:16");
+    gArgs.ForceSetArg("-dbcompression", "dbtest:1");
+
+    {
+        fs::path ph = fs::temp_directory_path() / fs::unique_path();
+        CDBWrapper dbw(ph, (1 << 20), true, false, false, "dbtest");
+        CDBWrapper unnamed(ph, (1 << 20), true, false, false);
+
+        CDBStats stats = dbw.GetStats();
+        BOOST_CHECK_EQUAL(stats.strName, "dbtest");
+        BOOST_CHECK_EQUAL(stats.nMaxOpenFiles, 100);
+        BOOST_CHECK_EQUAL(stats.nBloomBits, 0);
+        BOOST_CHECK_EQUAL(stats.nBlockSize, DEFAULT_DB_BLOCK_SIZE << 10);
+        BOOST_CHECK_EQUAL(stats.nBlockCacheSize, (1 << 20) / 2);
+        BOOST_CHECK_EQUAL(stats.nWriteBufferSize, (1 << 20) / 4);
+        BOOST_CHECK_EQUAL(unnamed.GetStats().nBloomBits, DEFAULT_DB_BLOOM_BITS);
+        // Compression is only reported when LevelDB can actually compress
+        BOOST_CHECK_EQUAL(stats.fCompression, DBCompressionAvailable());
+        BOOST_CHECK(!unnamed.GetStats().fCompression);
+
+        // Reads after a compaction go through the block cache
+        for (int i = 0; i < 100; i++)
+            BOOST_CHECK(dbw.Write(i, InsecureRand256()));
+        dbw.CompactRange(0, 100);
+        uint256 res;
+        for (int i = 0; i < 100; i++)
+            BOOST_CHECK(dbw.Read(i, res));
+        stats = dbw.GetStats();
+        BOOST_CHECK(stats.nBlockCacheHits + stats.nBlockCacheMisses > 0);
+        BOOST_CHECK(!stats.vLevels.empty());
+
+        // Only named databases are listed
+        std::vector<CDBStats> all = GetAllDBStats();
+        BOOST_CHECK_EQUAL(std::count_if(all.begin(), all.end(), [](const CDBStats& s) { return s.strName == "dbtest"; }), 1);
+        BOOST_CHECK_EQUAL(std::count_if(all.begin(), all.end(), [](const CDBStats& s) { return s.strName.empty(); }), 0);
+    }
+    std::vector<CDBStats> all = GetAllDBStats();
+    BOOST_CHECK_EQUAL(std::count_if(all.begin(), all.end(), [](const CDBStats& s) { return s.strName == "dbtest"; }), 0);
 
+    gArgs.ForceSetArg("-dbmaxopenfiles", std::to_string(DEFAULT_DB_MAX_OPEN_FILES));
+    gArgs.ForceSetArg("-dbbloombits", std::to_string(DEFAULT_DB_BLOOM_BITS));
+    gArgs.ForceSetArg("-dbblocksize", std::to_string(DEFAULT_DB_BLOCK_SIZE));
+    gArgs.ForceSetArg("-dbcompression", std::to_string(DEFAULT_DB_COMPRESSION));
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,62 @@
+// Copyright (c) 2018 The Litebitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "uint256.h"
+#include "utilstrencodings.h"
+#include "crypto/neoscrypt.h"
+#include "test/test_bitcoin.h"
+
+BOOST_FIXTURE_TEST_SUITE(neoscrypt_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(neoscrypt_known_answer)
+{
+    // The integrity test of the NeoScrypt reference implementation: bytes
+    // 0..79 hashed with profile 0. The batch kernel must produce the same
+    // digest in every lane, including the ones hashed by the scalar tail.
+    std::vector<unsigned char> input(80);
+    for (size_t i = 0; i < input.size(); i++)
+        input[i] = i;
+    const std::string expected = "7258961afb33fd12d00cacb8d63f4f4f52bb6917043865dd24a08f578853122d";
+
+    std::vector<unsigned char> output(32);
+    neoscrypt(&input[0], &output[0], 0x0);
+    BOOST_CHECK_EQUAL(HexStr(output), expected);
+
+    const size_t count = neoscrypt_batch_lanes() + 1;
+    std::vector<std::vector<unsigned char>> outputbytes(count, std::vector<unsigned char>(32));
+    std::vector<const unsigned char*> inputs(count, &input[0]);
+    std::vector<unsigned char*> outputs(count);
+    for (size_t i = 0; i < count; i++)
+        outputs[i] = &outputbytes[i][0];
+    neoscrypt_batch(&inputs[0], &outputs[0], count);
+    for (size_t i = 0; i < count; i++)
+        BOOST_CHECK_EQUAL(HexStr(outputbytes[i]), expected);
+}
+
+BOOST_AUTO_TEST_CASE(neoscrypt_batch_hashtest)
+{
+    // The batch API must match the reference neoscrypt() for any number of
+    // inputs, including counts that do not fill the multi-buffer kernel.
+    const size_t count = 2 * neoscrypt_batch_lanes() + 3;
+    std::vector<std::vector<unsigned char>> inputbytes(count);
+    std::vector<uint256> hashes(count);
+    std::vector<const unsigned char*> inputs(count);
+    std::vector<unsigned char*> outputs(count);
+    for (size_t i = 0; i < count; i++) {
+        inputbytes[i] = ParseHex("000000604c1271c211717198227392b029a64a7971931d351b387bb80db027f270411e398a07046f7d4a08dd815412a8712f874a7ebf0507e3878bd24e20a3b73fd750a667d2f451eac7471b00de6659");
+        inputbytes[i][76] = i & 0xff;
+        inputs[i] = &inputbytes[i][0];
+        outputs[i] = hashes[i].begin();
+    }
+    neoscrypt_batch(&inputs[0], &outputs[0], count);
+    for (size_t i = 0; i < count; i++) {
+        uint256 hash;
+        neoscrypt(inputs[i], hash.begin(), 0x0);
+        BOOST_CHECK_EQUAL(hashes[i].ToString(), hash.ToString());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -83,4 +83,29 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+/* The DarkGravityWave retargets on a fixed chain, before and after DivideSmall */
+BOOST_AUTO_TEST_CASE(dark_gravity_wave)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    // The first heights of the V1, V2 and V3 retargets, and the next work they give
+    const std::pair<int, unsigned int> tests[] = {
+        {3340, 0x1e03c9ce},
+        {68002, 0x1e03c9ce},
+        {95532, 0x1e03305a},
+    };
+    for (const auto& test : tests) {
+        // 30 blocks with varying targets and irregular, sometimes decreasing, times
+        std::vector<CBlockIndex> blocks(30);
+        uint32_t nRand = 12345;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            nRand = nRand * 1103515245 + 12345;
+            blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+            blocks[i].nHeight = test.first - blocks.size() + i;
+            blocks[i].nTime = 1500000000 + i * chainParams->GetConsensus().nPowTargetSpacing + (nRand >> 8) % 600 - 200;
+            blocks[i].nBits = ((0x1c + (nRand >> 4) % 3) << 24) | (0x010000 + (nRand >> 12) % 0x0f0000);
+        }
+        BOOST_CHECK_EQUAL(GetNextWorkRequired(&blocks.back(), nullptr, chainParams->GetConsensus()), test.second);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,101 @@
+// Copyright (c) 2018 The Litebitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "miner.h"
+#include "pow.h"
+#include "random.h"
+#include "script/script.h"
+#include "txdb.h"
+#include "validation.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+struct PoWHashSetup : public TestingSetup {
+    PoWHashSetup() : TestingSetup(CBaseChainParams::REGTEST) {}
+    ~PoWHashSetup() {
+        delete ppowhashdb;
+        ppowhashdb = nullptr;
+    }
+};
+
+/** Change the nonce of a header until its proof of work is as requested */
+static void SolveHeader(CBlockHeader& header, bool fValid)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    while (CheckProofOfWork(header.GetPoWHash(), header.nBits, consensusParams) != fValid)
+        ++header.nNonce;
+}
+
+BOOST_FIXTURE_TEST_SUITE(powhash_tests, PoWHashSetup)
+
+BOOST_AUTO_TEST_CASE(powhash_lookup)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    ppowhashdb = new CPoWHashDB(1 << 20, true);
+
+    CBlockHeader header = Params().GenesisBlock().GetBlockHeader();
+    header.hashPrevBlock = InsecureRand256();
+    SolveHeader(header, false);
+
+    // Unknown header: the hash is computed, whether or not the database is read
+    BOOST_CHECK(!CheckBlockProofOfWork(header, consensusParams));
+    BOOST_CHECK(!CheckBlockProofOfWork(header, consensusParams, true));
+
+    // A recorded hash is trusted, but only read when asked for
+    BOOST_CHECK(ppowhashdb->WritePoWHash(header.GetHash(), uint256()));
+    BOOST_CHECK(!CheckBlockProofOfWork(header, consensusParams));
+    BOOST_CHECK(CheckBlockProofOfWork(header, consensusParams, true));
+
+    // and is then known to the in-memory cache
+    BOOST_CHECK(CheckBlockProofOfWork(header, consensusParams));
+}
+
+BOOST_AUTO_TEST_CASE(powhash_persistence)
+{
+    const CChainParams& chainparams = Params();
+    ppowhashdb = new CPoWHashDB(1 << 20, false, true);
+
+    CScript scriptPubKey = CScript() << OP_TRUE;
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(scriptPubKey);
+    CBlock& block = pblocktemplate->block;
+    unsigned int extraNonce = 0;
+    {
+        LOCK(cs_main);
+        IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
+    }
+    CBlockHeader header = block.GetBlockHeader();
+    SolveHeader(header, true);
+
+    // Headers that do not make it into the block index are not recorded
+    CBlockHeader orphan = header;
+    orphan.hashPrevBlock = InsecureRand256();
+    SolveHeader(orphan, true);
+    CValidationState state;
+    BOOST_CHECK(!ProcessNewBlockHeaders({orphan}, state, chainparams));
+    uint256 hashPoW;
+    BOOST_CHECK(!ppowhashdb->ReadPoWHash(orphan.GetHash(), hashPoW));
+
+    BOOST_CHECK(ProcessNewBlockHeaders({header}, state, chainparams));
+    BOOST_CHECK(ppowhashdb->ReadPoWHash(header.GetHash(), hashPoW));
+    BOOST_CHECK(hashPoW == header.GetPoWHash());
+
+    // The hash survives reopening the database
+    delete ppowhashdb;
+    ppowhashdb = new CPoWHashDB(1 << 20);
+    BOOST_CHECK(ppowhashdb->ReadPoWHash(header.GetHash(), hashPoW));
+    BOOST_CHECK(hashPoW == header.GetPoWHash());
+
+    // and is dropped when the block is invalidated
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(InvalidateBlock(state, chainparams, mapBlockIndex[header.GetHash()]));
+    }
+    BOOST_CHECK(!ppowhashdb->ReadPoWHash(header.GetHash(), hashPoW));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -112,4 +112,50 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+BOOST_AUTO_TEST_CASE(singlethreadedclient_ordered)
+{
+    CScheduler scheduler;
+
+    // Jobs of one client run one at a time and in order, jobs of different
+    // clients may run side by side
+    std::shared_ptr<SingleThreadedSchedulerClient> queue[2];
+    int counter[2] = {0, 0};
+    bool fOrdered[2] = {true, true};
+    for (int i = 0; i < 2; i++) {
+        queue[i] = std::make_shared<SingleThreadedSchedulerClient>(&scheduler);
+        for (int j = 0; j < 300; j++) {
+            queue[i]->AddToProcessQueue([i, j, &counter, &fOrdered] {
+                fOrdered[i] = fOrdered[i] && counter[i] == j;
+                counter[i]++;
+            });
+        }
+        BOOST_CHECK_EQUAL(queue[i]->CallbacksPending(), 300);
+    }
+
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    scheduler.stop(true);
+    threads.join_all();
+
+    for (int i = 0; i < 2; i++) {
+        BOOST_CHECK(fOrdered[i]);
+        BOOST_CHECK_EQUAL(counter[i], 300);
+        SingleThreadedSchedulerClient::Stats stats;
+        queue[i]->GetStats(stats);
+        BOOST_CHECK_EQUAL(stats.nPending, 0);
+        BOOST_CHECK_EQUAL(stats.nProcessed, 300);
+        BOOST_CHECK_EQUAL(stats.nLag, 0);
+        BOOST_CHECK(stats.nMaxLag >= 0);
+    }
+
+    // Jobs that have not started can be dropped
+    queue[0]->AddToProcessQueue([&counter] { counter[0]++; });
+    BOOST_CHECK_EQUAL(queue[0]->CallbacksPending(), 1);
+    queue[0]->ClearQueue();
+    BOOST_CHECK_EQUAL(queue[0]->CallbacksPending(), 0);
+    queue[0]->EmptyQueue();
+    BOOST_CHECK_EQUAL(counter[0], 300);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
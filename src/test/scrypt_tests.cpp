@@ -32,4 +32,28 @@ BOOST_AUTO_TEST_CASE(scrypt_hashtest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(scrypt_batch_hashtest)
+{
+    // The batch API must match the single hash for any number of inputs,
+    // including counts that do not fill the multi-buffer kernel.
+    (void) scrypt_batch_autodetect();
+    const size_t count = 2 * scrypt_batch_lanes() + 3;
+    std::vector<std::vector<unsigned char>> inputbytes(count);
+    std::vector<uint256> hashes(count);
+    std::vector<const char*> inputs(count);
+    std::vector<char*> outputs(count);
+    for (size_t i = 0; i < count; i++) {
+        inputbytes[i] = ParseHex("020000004c1271c211717198227392b029a64a7971931d351b387bb80db027f270411e398a07046f7d4a08dd815412a8712f874a7ebf0507e3878bd24e20a3b73fd750a667d2f451eac7471b00de6659");
+        inputbytes[i][76] = i & 0xff;
+        inputs[i] = (const char*)&inputbytes[i][0];
+        outputs[i] = BEGIN(hashes[i]);
+    }
+    scrypt_1024_1_1_256_batch(&inputs[0], &outputs[0], count);
+    for (size_t i = 0; i < count; i++) {
+        uint256 scrypthash;
+        scrypt_1024_1_1_256(inputs[i], BEGIN(scrypthash));
+        BOOST_CHECK_EQUAL(hashes[i].ToString(), scrypthash.ToString());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
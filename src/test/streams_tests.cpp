@@ -71,6 +71,32 @@ BOOST_AUTO_TEST_CASE(streams_vector_writer)
     vch.clear();
 }
 
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    const char data[] = {1, 2, 0, 3, 4, 5, 6, 7};
+    CSpanReader reader(SER_NETWORK, INIT_PROTO_VERSION, data, data + sizeof(data));
+    BOOST_CHECK_EQUAL(reader.size(), 8);
+
+    unsigned char a, b;
+    uint16_t c;
+    reader >> a >> b;
+    BOOST_CHECK_EQUAL(a, 1);
+    BOOST_CHECK_EQUAL(b, 2);
+    reader.ignore(1);
+    reader >> c;
+    BOOST_CHECK_EQUAL(c, 0x0403);
+    BOOST_CHECK_EQUAL(reader.size(), 3);
+    BOOST_CHECK(!reader.empty());
+
+    // Reading past the end throws and leaves the reader where it was
+    uint32_t d;
+    BOOST_CHECK_THROW(reader >> d, std::ios_base::failure);
+    BOOST_CHECK_THROW(reader.ignore(4), std::ios_base::failure);
+    BOOST_CHECK_EQUAL(reader.size(), 3);
+    reader.ignore(3);
+    BOOST_CHECK(reader.empty());
+}
+
 BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
 {
     std::vector<char> in;
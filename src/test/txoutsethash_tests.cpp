@@ -0,0 +1,136 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txoutsethash.h"
+
+#include "coins.h"
+#include "streams.h"
+#include "test/test_bitcoin.h"
+#include "version.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txoutsethash_tests, BasicTestingSetup)
+
+static std::vector<std::pair<COutPoint, Coin> > RandomCoins(int nCount)
+{
+    std::vector<std::pair<COutPoint, Coin> > vCoins;
+    for (int i = 0; i < nCount; i++) {
+        CTxOut out;
+        out.nValue = InsecureRandRange(100000000);
+        out.scriptPubKey.assign(InsecureRandRange(40), 0x51);
+        vCoins.emplace_back(COutPoint(InsecureRand256(), InsecureRandRange(4)), Coin(out, InsecureRandRange(1000), InsecureRandBool()));
+    }
+    return vCoins;
+}
+
+BOOST_AUTO_TEST_CASE(txoutsethash_order)
+{
+    std::vector<std::pair<COutPoint, Coin> > vCoins = RandomCoins(50);
+
+    CTxOutSetHash forward, backward, partial;
+    for (const auto& coin : vCoins)
+        forward.Insert(coin.first, coin.second);
+    for (auto it = vCoins.rbegin(); it != vCoins.rend(); ++it)
+        backward.Insert(it->first, it->second);
+    BOOST_CHECK(forward.GetHash() == backward.GetHash());
+
+    // Hashing in between must not change the result
+    for (size_t i = 0; i < vCoins.size(); i++) {
+        partial.Insert(vCoins[i].first, vCoins[i].second);
+        if (i % 7 == 0)
+            partial.GetHash();
+    }
+    BOOST_CHECK(partial.GetHash() == forward.GetHash());
+
+    CAmount nTotal = 0;
+    uint64_t nBogoSize = 0;
+    for (const auto& coin : vCoins) {
+        nTotal += coin.second.out.nValue;
+        nBogoSize += 50 + coin.second.out.scriptPubKey.size();
+    }
+    BOOST_CHECK_EQUAL(forward.nTransactionOutputs, vCoins.size());
+    BOOST_CHECK_EQUAL(forward.nTotalAmount, nTotal);
+    BOOST_CHECK_EQUAL(forward.nBogoSize, nBogoSize);
+
+    // A different coin gives a different hash
+    CTxOutSetHash other = forward;
+    other.Remove(vCoins[0].first, vCoins[0].second);
+    Coin changed = vCoins[0].second;
+    changed.nHeight++;
+    other.Insert(vCoins[0].first, changed);
+    BOOST_CHECK(other.GetHash() != forward.GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(txoutsethash_remove)
+{
+    std::vector<std::pair<COutPoint, Coin> > vCoins = RandomCoins(20);
+    const uint256 hashEmpty = CTxOutSetHash().GetHash();
+
+    CTxOutSetHash hash, half;
+    for (size_t i = 0; i < vCoins.size(); i++) {
+        hash.Insert(vCoins[i].first, vCoins[i].second);
+        if (i % 2 == 0)
+            half.Insert(vCoins[i].first, vCoins[i].second);
+    }
+    for (size_t i = 1; i < vCoins.size(); i += 2)
+        hash.Remove(vCoins[i].first, vCoins[i].second);
+    BOOST_CHECK(hash.GetHash() == half.GetHash());
+    BOOST_CHECK_EQUAL(hash.nTransactionOutputs, half.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(hash.nTotalAmount, half.nTotalAmount);
+
+    // Removing everything, before or after combining, returns to the empty set
+    for (size_t i = 0; i < vCoins.size(); i += 2)
+        hash.Remove(vCoins[i].first, vCoins[i].second);
+    BOOST_CHECK(hash.GetHash() == hashEmpty);
+    BOOST_CHECK_EQUAL(hash.nTransactionOutputs, 0);
+    BOOST_CHECK_EQUAL(hash.nTotalAmount, 0);
+
+    CTxOutSetHash single;
+    single.Insert(vCoins[0].first, vCoins[0].second);
+    BOOST_CHECK(single.GetHash() != hashEmpty);
+    single.Remove(vCoins[0].first, vCoins[0].second);
+    BOOST_CHECK(single.GetHash() == hashEmpty);
+}
+
+BOOST_AUTO_TEST_CASE(txoutsethash_serialize)
+{
+    std::vector<std::pair<COutPoint, Coin> > vCoins = RandomCoins(10);
+
+    CTxOutSetHash hash;
+    for (const auto& coin : vCoins)
+        hash.Insert(coin.first, coin.second);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << hash;
+    CTxOutSetHash hash2;
+    ss >> hash2;
+    BOOST_CHECK(hash2.GetHash() == hash.GetHash());
+    BOOST_CHECK_EQUAL(hash2.nTransactionOutputs, hash.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(hash2.nBogoSize, hash.nBogoSize);
+    BOOST_CHECK_EQUAL(hash2.nTotalAmount, hash.nTotalAmount);
+
+    // The deserialized hash can be updated further
+    hash.Remove(vCoins[3].first, vCoins[3].second);
+    hash2.Remove(vCoins[3].first, vCoins[3].second);
+    BOOST_CHECK(hash2.GetHash() == hash.GetHash());
+
+    // The empty set round trips too
+    CDataStream ssEmpty(SER_DISK, CLIENT_VERSION);
+    ssEmpty << CTxOutSetHash();
+    CTxOutSetHash empty;
+    empty.Insert(vCoins[0].first, vCoins[0].second);
+    ssEmpty >> empty;
+    BOOST_CHECK(empty.GetHash() == CTxOutSetHash().GetHash());
+
+    // A point that is not on the curve is rejected
+    CDataStream ssBad(SER_DISK, CLIENT_VERSION);
+    ssBad << hash;
+    ssBad[ssBad.size() - 33] = 0x05;
+    BOOST_CHECK_THROW(ssBad >> hash2, std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
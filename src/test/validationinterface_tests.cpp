@@ -0,0 +1,82 @@
+// Copyright (c) 2018 The Litebitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "primitives/transaction.h"
+#include "scheduler.h"
+#include "validationinterface.h"
+
+#include "test/test_bitcoin.h"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, TestingSetup)
+
+/** Counts callbacks delivered after UnregisterValidationInterface returned */
+class TestSubscriber : public CValidationInterface
+{
+public:
+    std::atomic<bool> fUnregistered{false};
+    std::atomic<int> nLateCallbacks{0};
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& ptx) override
+    {
+        if (fUnregistered)
+            nLateCallbacks++;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(unregister_while_enqueueing)
+{
+    boost::thread_group threads;
+    for (int i = 0; i < 2; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    // Keep queueing notifications from another thread, like the message
+    // handler does while an RPC registers and unregisters its own subscriber
+    std::atomic<bool> fStop{false};
+    const CTransactionRef ptx = MakeTransactionRef(CMutableTransaction());
+    std::thread enqueuer([&fStop, &ptx] {
+        while (!fStop) {
+            GetMainSignals().TransactionAddedToMempool(ptx);
+            GetMainSignals().LimitQueues(MAX_PENDING_CALLBACKS);
+        }
+    });
+
+    // The subscribers outlive the scheduler threads, so a callback that
+    // reaches one too late is counted rather than run on a dead object
+    std::vector<std::unique_ptr<TestSubscriber>> subs;
+    for (int i = 0; i < 200; i++) {
+        subs.emplace_back(new TestSubscriber());
+        TestSubscriber* sub = subs.back().get();
+        RegisterValidationInterface(sub, "test");
+        GetMainSignals().SyncWithQueues(sub);
+        UnregisterValidationInterface(sub);
+        sub->fUnregistered = true;
+    }
+    fStop = true;
+    enqueuer.join();
+
+    // Anything queued for the subscribers was scheduled before this, so it
+    // has run or is running once this has run
+    std::promise<void> promise;
+    scheduler.schedule([&promise] { promise.set_value(); });
+    promise.get_future().wait();
+    scheduler.stop(false);
+    threads.join_all();
+
+    int nLateCallbacks = 0;
+    for (const auto& sub : subs)
+        nLateCallbacks += sub->nLateCallbacks;
+    BOOST_CHECK_EQUAL(nLateCallbacks, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+// Copyright (c) 2018 The Litebitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include "uint256.h"
+#include "utilstrencodings.h"
+#include "crypto/yescrypt/yescrypt-ctx.h"
+#include "test/test_bitcoin.h"
+
+BOOST_FIXTURE_TEST_SUITE(yescrypt_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(yescrypt_known_answer)
+{
+    // A yescrypt header and its hash as computed by the original
+    // yescrypt_hash(), before contexts were introduced
+    const std::vector<unsigned char> input = ParseHex("000000704c1271c211717198227392b029a64a7971931d351b387bb80db027f270411e398a07046f7d4a08dd815412a8712f874a7ebf0507e3878bd24e20a3b73fd750a667d2f451eac7471b00de6659");
+    const std::string expected = "13c5add6b846ad9006b1c922ed1b8c192b83a01b4f721fcf32c4bca9948e6ca7";
+
+    uint256 hash;
+    BOOST_CHECK_EQUAL(yescrypt_hash((const char*)&input[0], BEGIN(hash)), 0);
+    BOOST_CHECK_EQUAL(hash.ToString(), expected);
+
+    yescrypt_ctx_t* ctx = yescrypt_ctx_new();
+    BOOST_REQUIRE(ctx != nullptr);
+    BOOST_CHECK_EQUAL(yescrypt_hash_ctx(ctx, (const char*)&input[0], BEGIN(hash)), 0);
+    BOOST_CHECK_EQUAL(hash.ToString(), expected);
+    yescrypt_ctx_free(ctx);
+    yescrypt_thread_ctx_release();
+}
+
+BOOST_AUTO_TEST_CASE(yescrypt_ctx_hashtest)
+{
+    // Hashes computed with a reused context, in a batch or with the calling
+    // thread's context must all agree with a fresh context.
+    const size_t count = 3;
+    std::vector<std::vector<unsigned char>> inputbytes(count);
+    std::vector<uint256> hashes(count);
+    std::vector<const char*> inputs(count);
+    std::vector<char*> outputs(count);
+    for (size_t i = 0; i < count; i++) {
+        inputbytes[i] = ParseHex("000000704c1271c211717198227392b029a64a7971931d351b387bb80db027f270411e398a07046f7d4a08dd815412a8712f874a7ebf0507e3878bd24e20a3b73fd750a667d2f451eac7471b00de6659");
+        inputbytes[i][76] = i & 0xff;
+        inputs[i] = (const char*)&inputbytes[i][0];
+        outputs[i] = BEGIN(hashes[i]);
+    }
+
+    yescrypt_ctx_t* ctx = yescrypt_ctx_new();
+    BOOST_REQUIRE(ctx != nullptr);
+    BOOST_CHECK_EQUAL(yescrypt_hash_batch(ctx, &inputs[0], &outputs[0], count), 0);
+    BOOST_CHECK(yescrypt_ctx_size(ctx) > 0);
+    for (size_t i = 0; i < count; i++) {
+        uint256 hash, threadhash;
+        yescrypt_ctx_t* freshctx = yescrypt_ctx_new();
+        BOOST_REQUIRE(freshctx != nullptr);
+        BOOST_CHECK_EQUAL(yescrypt_hash_ctx(freshctx, inputs[i], BEGIN(hash)), 0);
+        yescrypt_ctx_free(freshctx);
+        BOOST_CHECK_EQUAL(yescrypt_hash(inputs[i], BEGIN(threadhash)), 0);
+        BOOST_CHECK_EQUAL(hashes[i].ToString(), hash.ToString());
+        BOOST_CHECK_EQUAL(threadhash.ToString(), hash.ToString());
+    }
+    yescrypt_ctx_free(ctx);
+    yescrypt_thread_ctx_release();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
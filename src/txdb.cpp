@@ -6,6 +6,7 @@
 #include "txdb.h"
 
 #include "chainparams.h"
+#include "checkqueue.h"
 #include "hash.h"
 #include "random.h"
 #include "pow.h"
@@ -21,14 +22,22 @@
 static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
-static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
+static const char DB_TXOUTSET_HASH = 'h';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_SNAPSHOT_BASE = 'S';
+
+static const char DB_POW_HASH = 'p';
+static const char DB_POW_HASH_VERSION = 'V';
+
+//! Version of the records in the PoW hash database. Version 1 also held the
+//! hashes of headers that never made it into the block index.
+static const int POW_HASH_DB_VERSION = 2;
 
 namespace {
 
@@ -54,25 +63,105 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe, bool fBackgroundFlushIn) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, "chainstate"), fBackgroundFlush(fBackgroundFlushIn), fWriteFailed(false)
+{
+}
+
+CCoinsViewDB::~CCoinsViewDB()
 {
+    if (!Sync())
+        LogPrintf("%s: background write to coin database failed\n", __func__);
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    if (fBackgroundFlush) {
+        std::lock_guard<std::mutex> lock(cs_pending);
+        if (pmapPending) {
+            CCoinsMap::const_iterator it = pmapPending->find(outpoint);
+            if (it != pmapPending->end()) {
+                coin = it->second.coin;
+                return !coin.IsSpent();
+            }
+        }
+    }
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
+size_t CCoinsViewDB::GetCoins(const std::vector<COutPoint> &outpoints, std::vector<Coin> &coins, std::vector<bool> &found) const {
+    coins.resize(outpoints.size());
+    found.assign(outpoints.size(), false);
+    size_t nFound = 0;
+
+    // Coins still being written by the background flush are answered from
+    // memory; only the others are read from the database.
+    std::vector<size_t> vIndex;
+    vIndex.reserve(outpoints.size());
+    {
+        std::unique_lock<std::mutex> lock(cs_pending, std::defer_lock);
+        if (fBackgroundFlush)
+            lock.lock();
+        for (size_t i = 0; i < outpoints.size(); i++) {
+            if (fBackgroundFlush && pmapPending) {
+                CCoinsMap::const_iterator it = pmapPending->find(outpoints[i]);
+                if (it != pmapPending->end()) {
+                    coins[i] = it->second.coin;
+                    if (!coins[i].IsSpent()) {
+                        found[i] = true;
+                        nFound++;
+                    }
+                    continue;
+                }
+            }
+            vIndex.push_back(i);
+        }
+    }
+    if (vIndex.empty())
+        return nFound;
+
+    std::vector<CoinEntry> vKeys;
+    vKeys.reserve(vIndex.size());
+    for (size_t i : vIndex)
+        vKeys.emplace_back(&outpoints[i]);
+    std::vector<Coin> vCoins;
+    std::vector<bool> vFound;
+    nFound += db.MultiRead(vKeys, vCoins, vFound);
+    for (size_t j = 0; j < vIndex.size(); j++) {
+        if (vFound[j]) {
+            coins[vIndex[j]] = std::move(vCoins[j]);
+            found[vIndex[j]] = true;
+        }
+    }
+    return nFound;
+}
+
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    if (fBackgroundFlush) {
+        std::lock_guard<std::mutex> lock(cs_pending);
+        if (pmapPending) {
+            CCoinsMap::const_iterator it = pmapPending->find(outpoint);
+            if (it != pmapPending->end())
+                return !it->second.coin.IsSpent();
+        }
+    }
     return db.Exists(CoinEntry(&outpoint));
 }
 
-uint256 CCoinsViewDB::GetBestBlock() const {
+uint256 CCoinsViewDB::ReadBestBlock() const {
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
     return hashBestChain;
 }
 
+uint256 CCoinsViewDB::GetBestBlock() const {
+    if (fBackgroundFlush) {
+        std::lock_guard<std::mutex> lock(cs_pending);
+        if (!hashPending.IsNull())
+            return hashPending;
+    }
+    return ReadBestBlock();
+}
+
 std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     std::vector<uint256> vhashHeadBlocks;
     if (!db.Read(DB_HEAD_BLOCKS, vhashHeadBlocks)) {
@@ -82,6 +171,56 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    if (!fBackgroundFlush)
+        return WriteCoins(mapCoins, hashBlock, true);
+
+    // Only one write may be in flight, as each one starts from the tip the
+    // previous one committed.
+    if (!Sync())
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(cs_pending);
+        pmapPending.reset(new CCoinsMap(std::move(mapCoins)));
+        mapCoins.clear();
+        hashPending = hashBlock;
+    }
+    threadWrite = std::thread(&CCoinsViewDB::ThreadWrite, this);
+    return true;
+}
+
+void CCoinsViewDB::ThreadWrite() {
+    RenameThread("bitcoin-coinsflush");
+    bool fOk = false;
+    try {
+        fOk = WriteCoins(*pmapPending, hashPending, false);
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+    if (!fOk) {
+        std::lock_guard<std::mutex> lock(cs_pending);
+        fWriteFailed = true;
+    }
+}
+
+bool CCoinsViewDB::Sync() {
+    if (threadWrite.joinable())
+        threadWrite.join();
+    std::lock_guard<std::mutex> lock(cs_pending);
+    // After a failure the pending entries are kept, so that lookups stay
+    // correct until the node shuts down.
+    if (fWriteFailed)
+        return false;
+    pmapPending.reset();
+    hashPending.SetNull();
+    return true;
+}
+
+bool CCoinsViewDB::BackgroundWriteFailed() const {
+    std::lock_guard<std::mutex> lock(cs_pending);
+    return fWriteFailed;
+}
+
+bool CCoinsViewDB::WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -89,7 +228,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
-    uint256 old_tip = GetBestBlock();
+    uint256 old_tip = ReadBestBlock();
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
         std::vector<uint256> old_heads = GetHeadBlocks();
@@ -116,8 +255,13 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        // A background write leaves the map alone, as lookups may read it.
+        if (fErase) {
+            CCoinsMap::iterator itOld = it++;
+            mapCoins.erase(itOld);
+        } else {
+            ++it;
+        }
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -147,7 +291,15 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+bool CCoinsViewDB::ReadTxOutSetHash(const uint256 &hashBlock, CTxOutSetHash &hash) const {
+    return db.Read(std::make_pair(DB_TXOUTSET_HASH, hashBlock), hash);
+}
+
+bool CCoinsViewDB::WriteTxOutSetHash(const uint256 &hashBlock, const CTxOutSetHash &hash) {
+    return db.Write(std::make_pair(DB_TXOUTSET_HASH, hashBlock), hash);
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, "blockindex") {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -172,7 +324,7 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
-    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), ReadBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
@@ -236,17 +388,6 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     return WriteBatch(batch, true);
 }
 
-bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
-}
-
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -259,53 +400,225 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+bool CBlockTreeDB::WriteSnapshotBase(const uint256 &hash, uint64_t nChainTx) {
+    return Write(DB_SNAPSHOT_BASE, std::make_pair(hash, nChainTx));
+}
+
+bool CBlockTreeDB::ReadSnapshotBase(uint256 &hash, uint64_t &nChainTx) {
+    std::pair<uint256, uint64_t> base;
+    if (!Read(DB_SNAPSHOT_BASE, base))
+        return false;
+    hash = base.first;
+    nChainTx = base.second;
+    return true;
+}
+
+namespace {
+
+/** Block index entries read from the database, to be deserialized and checked on a worker thread. */
+struct CBlockIndexChunk
+{
+    std::vector<CDataStream> vValues;
+    std::vector<CDiskBlockIndex> vIndex;
+    std::vector<uint256> vHash;
+    std::string strError;
+};
+
+/**
+ * Closure representing the deserialization of a chunk of block index entries,
+ * including the hash of each header, and the sanity check of their recorded
+ * proof of work hashes.
+ */
+class CBlockIndexLoadCheck
+{
+private:
+    CBlockIndexChunk *pchunk;
+    const Consensus::Params *pconsensusParams;
+    CPoWHashDB *ppowhashdb;
+
+public:
+    CBlockIndexLoadCheck(): pchunk(nullptr), pconsensusParams(nullptr), ppowhashdb(nullptr) {}
+    CBlockIndexLoadCheck(CBlockIndexChunk& chunkIn, const Consensus::Params& consensusParamsIn, CPoWHashDB* ppowhashdbIn) :
+        pchunk(&chunkIn), pconsensusParams(&consensusParamsIn), ppowhashdb(ppowhashdbIn) {}
+
+    bool operator()() {
+        CBlockIndexChunk& chunk = *pchunk;
+        chunk.vIndex.resize(chunk.vValues.size());
+        chunk.vHash.resize(chunk.vValues.size());
+        for (size_t i = 0; i < chunk.vValues.size(); i++) {
+            try {
+                chunk.vValues[i] >> chunk.vIndex[i];
+            } catch (const std::exception&) {
+                chunk.strError = "failed to read value";
+                return false;
+            }
+            chunk.vHash[i] = chunk.vIndex[i].GetBlockHash();
+
+            // Litebitcoin: We use the sha256 hash for the block index for performance reasons.
+            // CheckProofOfWork() needs the scrypt/neoscrypt/yescrypt hash, and recomputing
+            // it for every block during every Litebitcoin startup would take several minutes.
+            // Only sanity check the headers whose PoW hash was recorded when they were
+            // accepted, and simply trust the rest of the data that is on your local disk.
+            uint256 hashPoW;
+            if (ppowhashdb && ppowhashdb->ReadPoWHash(chunk.vHash[i], hashPoW) &&
+                !CheckProofOfWork(hashPoW, chunk.vIndex[i].nBits, *pconsensusParams)) {
+                chunk.strError = strprintf("CheckProofOfWork failed: height=%d, hash=%s", chunk.vIndex[i].nHeight, chunk.vHash[i].ToString());
+                return false;
+            }
+        }
+        chunk.vValues.clear();
+        return true;
+    }
+
+    void swap(CBlockIndexLoadCheck &check) {
+        std::swap(pchunk, check.pchunk);
+        std::swap(pconsensusParams, check.pconsensusParams);
+        std::swap(ppowhashdb, check.ppowhashdb);
+    }
+};
+
+/** Number of entries deserialized by one CBlockIndexLoadCheck. */
+const size_t BLOCK_INDEX_CHUNK_SIZE = 1024;
+/** Number of chunks read from the cursor before they are handed to the workers. */
+const size_t BLOCK_INDEX_BATCH_CHUNKS = 16;
+
+} // namespace
+
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, CPoWHashDB* ppowhashdb, int nThreads)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                // Litebitcoin: Disable PoW Sanity check while loading block index from disk.
-                // We use the sha256 hash for the block index for performance reasons, which is recorded for later use.
-                // CheckProofOfWork() uses the scrypt hash which is discarded after a block is accepted.
-                // While it is technically feasible to verify the PoW, doing so takes several minutes as it
-                // requires recomputing every PoW hash during every Litebitcoin startup.
-                // We opt instead to simply trust the data that is on your local disk.
-                //if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, consensusParams))
-                //    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
-
+    // The cursor is read on this thread, one batch ahead of the workers that
+    // deserialize and check the entries. Their results are inserted into
+    // mapBlockIndex in database order, one batch behind.
+    CCheckQueue<CBlockIndexLoadCheck> queue(1);
+    boost::thread_group workers;
+    for (int i = 0; i < nThreads - 1; i++)
+        workers.create_thread([&queue] { queue.Thread(); });
+
+    bool fOk = true;
+    std::deque<CBlockIndexChunk> vChecking, vDone;
+    std::unique_ptr<CCheckQueueControl<CBlockIndexLoadCheck> > control;
+    bool fMore = true;
+    try {
+        while (fOk && (fMore || !vChecking.empty())) {
+            // Load mapBlockIndex
+            std::deque<CBlockIndexChunk> vRead;
+            while (fMore && vRead.size() < BLOCK_INDEX_BATCH_CHUNKS) {
+                boost::this_thread::interruption_point();
+                std::pair<char, uint256> key;
+                if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX) {
+                    fMore = false;
+                    break;
+                }
+                if (vRead.empty() || vRead.back().vValues.size() >= BLOCK_INDEX_CHUNK_SIZE)
+                    vRead.emplace_back();
+                vRead.back().vValues.emplace_back(SER_DISK, CLIENT_VERSION);
+                pcursor->GetValueStream(vRead.back().vValues.back());
                 pcursor->Next();
-            } else {
-                return error("%s: failed to read value", __func__);
             }
-        } else {
-            break;
+
+            if (control)
+                control->Wait();
+            control.reset();
+            vDone.swap(vChecking);
+            vChecking.swap(vRead);
+            if (!vChecking.empty()) {
+                std::vector<CBlockIndexLoadCheck> vChecks;
+                for (CBlockIndexChunk& chunk : vChecking)
+                    vChecks.emplace_back(chunk, consensusParams, ppowhashdb);
+                control.reset(new CCheckQueueControl<CBlockIndexLoadCheck>(&queue));
+                control->Add(vChecks);
+            }
+
+            for (const CBlockIndexChunk& chunk : vDone) {
+                if (!chunk.strError.empty()) {
+                    fOk = error("%s: %s", __func__, chunk.strError);
+                    break;
+                }
+                for (size_t i = 0; i < chunk.vIndex.size(); i++) {
+                    const CDiskBlockIndex& diskindex = chunk.vIndex[i];
+                    // Construct block index object
+                    CBlockIndex* pindexNew = insertBlockIndex(chunk.vHash[i]);
+                    pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
+                    pindexNew->nHeight        = diskindex.nHeight;
+                    pindexNew->nFile          = diskindex.nFile;
+                    pindexNew->nDataPos       = diskindex.nDataPos;
+                    pindexNew->nUndoPos       = diskindex.nUndoPos;
+                    pindexNew->nVersion       = diskindex.nVersion;
+                    pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+                    pindexNew->nTime          = diskindex.nTime;
+                    pindexNew->nBits          = diskindex.nBits;
+                    pindexNew->nNonce         = diskindex.nNonce;
+                    pindexNew->nStatus        = diskindex.nStatus;
+                    pindexNew->nTx            = diskindex.nTx;
+                }
+            }
+            vDone.clear();
         }
+    } catch (...) {
+        control.reset();
+        workers.interrupt_all();
+        workers.join_all();
+        throw;
     }
+    control.reset();
+    workers.interrupt_all();
+    workers.join_all();
 
-    return true;
+    return fOk;
+}
+
+CPoWHashDB::CPoWHashDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "powhash", nCacheSize, fMemory, fWipe, false, "powhash") {
+}
+
+bool CPoWHashDB::ReadPoWHash(const uint256 &hash, uint256 &hashPoW) {
+    return Read(std::make_pair(DB_POW_HASH, hash), hashPoW);
+}
+
+bool CPoWHashDB::WritePoWHash(const uint256 &hash, const uint256 &hashPoW) {
+    return Write(std::make_pair(DB_POW_HASH, hash), hashPoW);
+}
+
+bool CPoWHashDB::ErasePoWHash(const uint256 &hash) {
+    return Erase(std::make_pair(DB_POW_HASH, hash));
+}
+
+bool CPoWHashDB::Upgrade() {
+    int nVersion = 0;
+    if (Read(DB_POW_HASH_VERSION, nVersion) && nVersion == POW_HASH_DB_VERSION) {
+        return true;
+    }
+
+    // Datadirs from before this database existed simply start out empty; the
+    // hashes are recorded as headers get verified again. Records of any other
+    // version cannot be trusted and are dropped.
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_POW_HASH, uint256()));
+    if (pcursor->Valid()) {
+        LogPrintf("Dropping PoW hash database records of version %d...\n", nVersion);
+    }
+    size_t batch_size = 1 << 24;
+    CDBBatch batch(*this);
+    std::pair<char, uint256> key;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (!pcursor->GetKey(key) || key.first != DB_POW_HASH) {
+            break;
+        }
+        batch.Erase(key);
+        if (batch.SizeEstimate() > batch_size) {
+            if (!WriteBatch(batch)) {
+                return false;
+            }
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+    batch.Write(DB_POW_HASH_VERSION, POW_HASH_DB_VERSION);
+    return WriteBatch(batch, true);
 }
 
 namespace {
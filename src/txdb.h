@@ -9,14 +9,19 @@
 #include "coins.h"
 #include "dbwrapper.h"
 #include "chain.h"
+#include "txoutsethash.h"
 
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 class CBlockIndex;
 class CCoinsViewDBCursor;
+class CPoWHashDB;
 class uint256;
 
 //! No need to periodic flush if at least this much space still available.
@@ -25,18 +30,26 @@ static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
 static const int64_t nDefaultDbCache = 450;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -dbbackgroundflush default
+static const bool DEFAULT_DB_BACKGROUND_FLUSH = true;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
 static const int64_t nMinDbCache = 4;
-//! Max memory allocated to block tree DB specific cache, if no -txindex (MiB)
+//! Max memory allocated to block tree DB specific cache (MiB)
 static const int64_t nMaxBlockDBCache = 2;
-//! Max memory allocated to block tree DB specific cache, if -txindex (MiB)
+//! Max memory allocated to tx index DB specific cache (MiB)
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
-static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
+static const int64_t nMaxTxIndexCache = 1024;
+//! Max memory allocated to address index DB specific cache (MiB)
+static const int64_t nMaxAddressIndexCache = 1024;
+//! Max memory allocated to block filter index DB specific cache (MiB)
+static const int64_t nMaxFilterIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Max memory allocated to PoW hash DB specific cache (MiB)
+static const int64_t nMaxPoWHashDBCache = 8;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -64,14 +77,41 @@ struct CDiskTxPos : public CDiskBlockPos
 };
 
 /** CCoinsView backed by the coin database (chainstate/) */
+/**
+ * CCoinsView backed by the coin database.
+ *
+ * With fBackgroundFlush, BatchWrite() takes over the entries it is given and
+ * returns right away, while a background thread writes them in batches of
+ * -dbbatchsize. The head blocks markers are written exactly as in a
+ * synchronous flush, so ReplayBlocks() can recover from a crash in the middle.
+ * Until the write has finished, lookups are answered from the entries being
+ * written; Cursor() and EstimateSize() only see what has been committed, so
+ * call Sync() before using them.
+ */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
+
+private:
+    const bool fBackgroundFlush;
+    mutable std::mutex cs_pending;
+    //! Entries being written by threadWrite; not modified until it is joined.
+    std::unique_ptr<CCoinsMap> pmapPending;
+    uint256 hashPending;
+    bool fWriteFailed;
+    std::thread threadWrite;
+
+    uint256 ReadBestBlock() const;
+    bool WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase);
+    void ThreadWrite();
+
 public:
-    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool fBackgroundFlushIn = false);
+    ~CCoinsViewDB();
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    size_t GetCoins(const std::vector<COutPoint> &outpoints, std::vector<Coin> &coins, std::vector<bool> &found) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
@@ -81,6 +121,15 @@ public:
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    //! Wait for a background write to finish. Returns false if it failed.
+    bool Sync();
+    //! Whether a background write has failed (without waiting for one in progress).
+    bool BackgroundWriteFailed() const;
+
+    //! Rolling UTXO set hash after the given block, see -txoutsethash
+    bool ReadTxOutSetHash(const uint256 &hashBlock, CTxOutSetHash &hash) const;
+    bool WriteTxOutSetHash(const uint256 &hashBlock, const CTxOutSetHash &hash);
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -119,11 +168,32 @@ public:
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
-    bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    bool WriteSnapshotBase(const uint256 &hash, uint64_t nChainTx);
+    bool ReadSnapshotBase(uint256 &hash, uint64_t &nChainTx);
+    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, CPoWHashDB* ppowhashdb = nullptr, int nThreads = 0);
+};
+
+/**
+ * Access to the proof of work hashes of the headers in the block index
+ * (blocks/powhash/), keyed by block hash. This is kept out of the block tree
+ * database so that it survives -reindex. Hashes of headers that never made
+ * it into the block index or turned out invalid are not kept.
+ */
+class CPoWHashDB : public CDBWrapper
+{
+public:
+    CPoWHashDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+private:
+    CPoWHashDB(const CPoWHashDB&);
+    void operator=(const CPoWHashDB&);
+public:
+    bool ReadPoWHash(const uint256 &hash, uint256 &hashPoW);
+    bool WritePoWHash(const uint256 &hash, const uint256 &hashPoW);
+    bool ErasePoWHash(const uint256 &hash);
+    //! Attempt to update from an older database format. Returns false if an error occurred.
+    bool Upgrade();
 };
 
 #endif // BITCOIN_TXDB_H
@@ -0,0 +1,133 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txoutsethash.h"
+
+#include "coins.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "version.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace {
+
+/** Parsing, negating and adding points needs no precomputed tables. */
+const secp256k1_context* GetContext()
+{
+    static const secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_NONE);
+    return ctx;
+}
+
+/** Map a coin to a point: the first candidate x coordinate that is on the curve, with even y. */
+void HashToPoint(const COutPoint& outpoint, const Coin& coin, secp256k1_pubkey& point)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << outpoint << coin;
+    const uint256 seed = ss.GetHash();
+
+    unsigned char vch[33];
+    vch[0] = 0x02;
+    for (uint32_t nCounter = 0; ; nCounter++) {
+        unsigned char counter[4];
+        WriteLE32(counter, nCounter);
+        CSHA256().Write(seed.begin(), seed.size()).Write(counter, sizeof(counter)).Finalize(vch + 1);
+        if (secp256k1_ec_pubkey_parse(GetContext(), &point, vch, sizeof(vch)))
+            return;
+    }
+}
+
+/** Number of pending points above which they are added up, to bound memory use. */
+const size_t MAX_PENDING_POINTS = 4096;
+
+uint64_t BogoSize(const Coin& coin)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + coin.out.scriptPubKey.size() /* scriptPubKey */;
+}
+
+} // namespace
+
+void CTxOutSetHash::Insert(const COutPoint& outpoint, const Coin& coin)
+{
+    vPending.emplace_back();
+    HashToPoint(outpoint, coin, vPending.back());
+    nTransactionOutputs++;
+    nBogoSize += BogoSize(coin);
+    nTotalAmount += coin.out.nValue;
+    if (vPending.size() >= MAX_PENDING_POINTS)
+        Combine();
+}
+
+void CTxOutSetHash::Remove(const COutPoint& outpoint, const Coin& coin)
+{
+    vPending.emplace_back();
+    HashToPoint(outpoint, coin, vPending.back());
+    int ret = secp256k1_ec_pubkey_negate(GetContext(), &vPending.back());
+    assert(ret);
+    nTransactionOutputs--;
+    nBogoSize -= BogoSize(coin);
+    nTotalAmount -= coin.out.nValue;
+    if (vPending.size() >= MAX_PENDING_POINTS)
+        Combine();
+}
+
+void CTxOutSetHash::Combine() const
+{
+    if (vPending.empty())
+        return;
+    // All points are added up in one go, which only converts the sum back to
+    // affine coordinates once.
+    std::vector<const secp256k1_pubkey*> vPoints;
+    vPoints.reserve(vPending.size() + 1);
+    if (!fEmpty)
+        vPoints.push_back(&point);
+    for (const secp256k1_pubkey& pending : vPending) {
+        vPoints.push_back(&pending);
+    }
+    // The sum is only invalid if it is the point at infinity, which is the
+    // hash of the empty set.
+    secp256k1_pubkey sum;
+    fEmpty = !secp256k1_ec_pubkey_combine(GetContext(), &sum, vPoints.data(), vPoints.size());
+    if (!fEmpty)
+        point = sum;
+    vPending.clear();
+}
+
+void CTxOutSetHash::GetPoint(unsigned char vch[33]) const
+{
+    Combine();
+    if (fEmpty) {
+        memset(vch, 0, 33);
+        return;
+    }
+    size_t nSize = 33;
+    int ret = secp256k1_ec_pubkey_serialize(GetContext(), vch, &nSize, &point, SECP256K1_EC_COMPRESSED);
+    assert(ret && nSize == 33);
+}
+
+bool CTxOutSetHash::SetPoint(const unsigned char vch[33])
+{
+    vPending.clear();
+    fEmpty = vch[0] == 0;
+    if (fEmpty) {
+        for (int i = 1; i < 33; i++) {
+            if (vch[i] != 0)
+                return false;
+        }
+        return true;
+    }
+    return secp256k1_ec_pubkey_parse(GetContext(), &point, vch, 33);
+}
+
+uint256 CTxOutSetHash::GetHash() const
+{
+    unsigned char vch[33];
+    GetPoint(vch);
+    uint256 hash;
+    CSHA256().Write(vch, sizeof(vch)).Finalize(hash.begin());
+    return hash;
+}
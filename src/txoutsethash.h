@@ -0,0 +1,78 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TXOUTSETHASH_H
+#define BITCOIN_TXOUTSETHASH_H
+
+#include "amount.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <vector>
+
+#include <secp256k1.h>
+
+class COutPoint;
+class Coin;
+
+/**
+ * Rolling hash and totals of a set of coins.
+ *
+ * The hash is an elliptic curve multiset hash: every coin is mapped to a
+ * point on secp256k1 and the set to the sum of those points. Coins can be
+ * inserted and removed in any order, so the hash of the UTXO set after a
+ * block follows from the one before it and the coins the block creates and
+ * spends, without looking at the rest of the set.
+ *
+ * Serialized format:
+ * - the number of coins, their bogosize and their total amount
+ * - the sum of the points as a compressed public key, or 33 zero bytes for
+ *   the empty set
+ */
+class CTxOutSetHash
+{
+private:
+    //! Sum of the points of the combined coins, unless fEmpty
+    mutable secp256k1_pubkey point;
+    mutable bool fEmpty;
+    //! Points inserted or removed (negated) since the last Combine()
+    mutable std::vector<secp256k1_pubkey> vPending;
+
+    void Combine() const;
+    void GetPoint(unsigned char vch[33]) const;
+    bool SetPoint(const unsigned char vch[33]);
+
+public:
+    uint64_t nTransactionOutputs;
+    uint64_t nBogoSize;
+    CAmount nTotalAmount;
+
+    CTxOutSetHash() : fEmpty(true), nTransactionOutputs(0), nBogoSize(0), nTotalAmount(0) {}
+
+    void Insert(const COutPoint& outpoint, const Coin& coin);
+    void Remove(const COutPoint& outpoint, const Coin& coin);
+
+    /** Hash of the set, which only depends on the coins in it. */
+    uint256 GetHash() const;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        unsigned char vch[33];
+        GetPoint(vch);
+        s << VARINT(nTransactionOutputs) << VARINT(nBogoSize) << nTotalAmount;
+        s.write((const char*)vch, sizeof(vch));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        unsigned char vch[33];
+        s >> VARINT(nTransactionOutputs) >> VARINT(nBogoSize) >> nTotalAmount;
+        s.read((char*)vch, sizeof(vch));
+        if (!SetPoint(vch))
+            throw std::ios_base::failure("invalid UTXO set hash point");
+    }
+};
+
+#endif // BITCOIN_TXOUTSETHASH_H
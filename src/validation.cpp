@@ -14,9 +14,14 @@
 #include "consensus/merkle.h"
 #include "consensus/tx_verify.h"
 #include "consensus/validation.h"
+#include "crypto/common.h"
+#include "crypto/neoscrypt.h"
+#include "crypto/scrypt.h"
+#include "crypto/yescrypt/yescrypt-ctx.h"
 #include "cuckoocache.h"
 #include "fs.h"
 #include "hash.h"
+#include "index/txindex.h"
 #include "init.h"
 #include "policy/fees.h"
 #include "policy/policy.h"
@@ -43,7 +48,14 @@
 #include "warnings.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <list>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <type_traits>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -67,13 +79,16 @@ CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 bool fReindex = false;
-bool fTxIndex = false;
+bool fTxOutSetHash = DEFAULT_TXOUTSETHASH;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+bool fCheckBlockReadPoW = DEFAULT_CHECK_BLOCK_READ_POW;
+int nBlockFileMaps = DEFAULT_BLOCK_FILE_MAPS;
+bool fPrefetchCoins = DEFAULT_PREFETCH_COINS;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
@@ -98,6 +113,20 @@ const std::string strMessageMagic = "Litebitcoin Signed Message:\n";
 // Internal stuff
 namespace {
 
+    /**
+     * The CBlockIndex entries of mapBlockIndex are carved out of large chunks
+     * instead of being allocated one by one. They are never freed on their
+     * own: UnloadBlockIndex drops the whole pool at once.
+     */
+    typedef PoolResource<sizeof(CBlockIndex), alignof(CBlockIndex)> CBlockIndexPool;
+    static_assert(std::is_trivially_destructible<CBlockIndex>::value, "CBlockIndex entries are released without running their destructor");
+    std::unique_ptr<CBlockIndexPool> pblockindexpool(new CBlockIndexPool());
+
+    CBlockIndex* NewBlockIndex(const CBlockHeader& block)
+    {
+        return new (pblockindexpool->Allocate(sizeof(CBlockIndex), alignof(CBlockIndex))) CBlockIndex(block);
+    }
+
     struct CBlockIndexWorkComparator
     {
         bool operator()(const CBlockIndex *pa, const CBlockIndex *pb) const {
@@ -178,6 +207,12 @@ namespace {
 
     /** Dirty block file entries. */
     std::set<int> setDirtyFileInfo;
+
+    /**
+     * The block the chain state was loaded at from a UTXO set snapshot, if
+     * any. Its ancestors are only known by their headers.
+     */
+    uint256 hashSnapshotBase;
 } // anon namespace
 
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator)
@@ -201,6 +236,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 CCoinsViewDB *pcoinsdbview = nullptr;
 CCoinsViewCache *pcoinsTip = nullptr;
 CBlockTreeDB *pblocktree = nullptr;
+CPoWHashDB *ppowhashdb = nullptr;
 
 enum FlushStateMode {
     FLUSH_STATE_NONE,
@@ -215,6 +251,8 @@ static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPr
 static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
 static FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
+static bool MapDiskRecord(const CDiskBlockPos& pos, const char* prefix, size_t nTrailer, std::shared_ptr<const fsbridge::MappedFile>& mapping, const char*& pbegin, const char*& pend);
+static void UnmapDiskFiles(int nFile);
 
 bool CheckFinalTx(const CTransaction &tx, int flags)
 {
@@ -931,25 +969,9 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
         return true;
     }
 
-    if (fTxIndex) {
-        CDiskTxPos postx;
-        if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
-            CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            }
-            hashBlock = header.GetHash();
-            if (txOut->GetHash() != hash)
-                return error("%s: txid mismatch", __func__);
-            return true;
-        }
+    // While the index is still catching up, fall back to the slow lookup
+    if (g_txindex && g_txindex->FindTx(hash, hashBlock, txOut)) {
+        return true;
     }
 
     if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
@@ -1004,33 +1026,171 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+/**
+ * Headers that passed the proof of work check in this process, so that the
+ * memory-hard hash of a header is computed at most once per process even if
+ * ppowhashdb is not in use. Entries are SHA256(nonce || block hash). Lookups
+ * take a shared lock, so the header check queue workers do not serialize.
+ */
+static CuckooCache::cache<uint256, SignatureCacheHasher> powCache;
+static uint256 powCacheNonce(GetRandHash());
+static boost::shared_mutex cs_powcache;
+
+void InitPoWCache() {
+    // nMaxCacheSize is unsigned. If -powcachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-powcachesize", DEFAULT_POW_CACHE_SIZE)), MAX_POW_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems;
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_powcache);
+        nElems = powCache.setup_bytes(nMaxCacheSize);
+    }
+    LogPrintf("Using %zu MiB out of %zu requested for proof of work cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+static uint256 PoWCacheEntry(const uint256& hash)
 {
-    block.SetNull();
+    uint256 entry;
+    CSHA256().Write(powCacheNonce.begin(), 32).Write(hash.begin(), 32).Finalize(entry.begin());
+    return entry;
+}
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+/**
+ * PoW hashes computed by CheckBlockProofOfWork() that are not in ppowhashdb
+ * yet. A hash is only recorded once AcceptBlockHeader() has added its header
+ * to mapBlockIndex, so that peers cannot fill the database with headers that
+ * never connect; this map is bounded for the same reason.
+ */
+static std::map<uint256, uint256> mapUnrecordedPoWHashes;
+static CCriticalSection cs_unrecordedpowhashes;
+static const size_t MAX_UNRECORDED_POW_HASHES = 8192;
 
-    // Read block
-    try {
-        filein >> block;
+/** Record the PoW hash of a header that was added to mapBlockIndex in ppowhashdb. */
+static void RecordPoWHash(const uint256& hash)
+{
+    uint256 hashPoW;
+    {
+        LOCK(cs_unrecordedpowhashes);
+        std::map<uint256, uint256>::iterator it = mapUnrecordedPoWHashes.find(hash);
+        if (it == mapUnrecordedPoWHashes.end())
+            return;
+        hashPoW = it->second;
+        mapUnrecordedPoWHashes.erase(it);
     }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    if (ppowhashdb && !ppowhashdb->WritePoWHash(hash, hashPoW))
+        LogPrintf("%s: failed to record PoW hash of %s\n", __func__, hash.ToString());
+}
+
+/** Drop the PoW hash of an invalid block from ppowhashdb. */
+static void ForgetPoWHash(const uint256& hash)
+{
+    {
+        LOCK(cs_unrecordedpowhashes);
+        mapUnrecordedPoWHashes.erase(hash);
+    }
+    if (ppowhashdb && !ppowhashdb->ErasePoWHash(hash))
+        LogPrintf("%s: failed to erase PoW hash of %s\n", __func__, hash.ToString());
+}
+
+/**
+ * Look up the outcome of the proof of work check of a header (whose hash is
+ * given) without computing the memory-hard hash. ppowhashdb is only read if
+ * fReadDB. Returns false if the header could not be looked up.
+ */
+static bool LookupBlockProofOfWork(const CBlockHeader& block, const uint256& hash, const Consensus::Params& consensusParams, bool fReadDB, bool& fValid)
+{
+    const uint256 entry = PoWCacheEntry(hash);
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_powcache);
+        if (powCache.contains(entry, false)) {
+            fValid = true;
+            return true;
+        }
+    }
+
+    uint256 hashPoW;
+    if (!fReadDB || ppowhashdb == nullptr || !ppowhashdb->ReadPoWHash(hash, hashPoW))
+        return false;
+    fValid = CheckProofOfWork(hashPoW, block.nBits, consensusParams);
+    if (fValid) {
+        boost::unique_lock<boost::shared_mutex> lock(cs_powcache);
+        powCache.insert(entry);
+    }
+    return true;
+}
+
+bool CheckBlockProofOfWork(const CBlockHeader& block, const Consensus::Params& consensusParams, bool fReadDB, const uint256* phashPoW)
+{
+    const uint256 hash = block.GetHash();
+    bool fValid;
+    if (phashPoW == nullptr && LookupBlockProofOfWork(block, hash, consensusParams, fReadDB, fValid))
+        return fValid;
+
+    const uint256 hashPoW = phashPoW ? *phashPoW : block.GetPoWHash();
+    if (!CheckProofOfWork(hashPoW, block.nBits, consensusParams))
+        return false;
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_powcache);
+        powCache.insert(PoWCacheEntry(hash));
+    }
+    if (ppowhashdb) {
+        LOCK(cs_unrecordedpowhashes);
+        if (mapUnrecordedPoWHashes.size() >= MAX_UNRECORDED_POW_HASHES)
+            mapUnrecordedPoWHashes.erase(mapUnrecordedPoWHashes.begin());
+        mapUnrecordedPoWHashes[hash] = hashPoW;
+    }
+    return true;
+}
+
+static bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPOW)
+{
+    block.SetNull();
+
+    std::shared_ptr<const fsbridge::MappedFile> mapping;
+    const char *pbegin, *pend;
+    if (MapDiskRecord(pos, "blk", 0, mapping, pbegin, pend)) {
+        // Read block straight from the mapped file
+        try {
+            CSpanReader(SER_DISK, CLIENT_VERSION, pbegin, pend) >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     // Check the header
-    if (!CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
+    if (fCheckPOW && !CheckBlockProofOfWork(block, consensusParams, true))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
 
     return true;
 }
 
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+{
+    // Nothing is known about the data at a bare position, so always check the header.
+    return ReadBlockFromDisk(block, pos, consensusParams, true);
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams))
+    // The proof of work of every header in mapBlockIndex was checked when it was
+    // accepted, and the hash comparison below ties the data on disk to that header,
+    // so the (memory-hard) PoW hash is only recomputed with -checkblockreadpow.
+    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams, fCheckBlockReadPoW))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
@@ -1402,6 +1562,7 @@ void static InvalidBlockFound(CBlockIndex *pindex, const CValidationState &state
         g_failed_blocks.insert(pindex);
         setDirtyBlockIndex.insert(pindex);
         setBlockIndexCandidates.erase(pindex);
+        ForgetPoWHash(pindex->GetBlockHash());
         InvalidChainFound(pindex);
     }
 }
@@ -1555,8 +1716,6 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
     return true;
 }
 
-namespace {
-
 bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
@@ -1586,6 +1745,25 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
+    std::shared_ptr<const fsbridge::MappedFile> mapping;
+    const char *pbegin, *pend;
+    if (MapDiskRecord(pos, "rev", sizeof(uint256), mapping, pbegin, pend)) {
+        // The checksum covers the raw bytes, so verify it before deserializing
+        const char* pchecksum = pend - sizeof(uint256);
+        CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+        hasher << hashBlock;
+        hasher.write(pbegin, pchecksum - pbegin);
+        if (memcmp(pchecksum, hasher.GetHash().begin(), sizeof(uint256)))
+            return error("%s: Checksum mismatch", __func__);
+        try {
+            CSpanReader(SER_DISK, CLIENT_VERSION, pbegin, pchecksum) >> blockundo;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s", __func__, e.what());
+        }
+        return true;
+    }
+
     // Open history file to read
     CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
@@ -1610,6 +1788,8 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uin
     return true;
 }
 
+namespace {
+
 /** Abort with a message */
 bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1630,6 +1810,15 @@ bool AbortNode(CValidationState& state, const std::string& strMessage, const std
 
 } // namespace
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    CDiskBlockPos pos = pindex->GetUndoPos();
+    if (pos.IsNull()) {
+        return error("%s: no undo data available for block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+    return UndoReadFromDisk(blockundo, pos, pindex->pprev->GetBlockHash());
+}
+
 enum DisconnectResult
 {
     DISCONNECT_OK,      // All good.
@@ -1741,6 +1930,10 @@ void static FlushBlockFile(bool fFinalize = false)
 
     CDiskBlockPos posOld(nLastBlockFile, 0);
 
+    // Readers must not see the truncated tail of the files through a mapping
+    if (fFinalize)
+        UnmapDiskFiles(nLastBlockFile);
+
     FILE *fileOld = OpenBlockFile(posOld);
     if (fileOld) {
         if (fFinalize)
@@ -1767,6 +1960,213 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Closure representing the context-free proof of work check of a group of
+ * headers. The outcome for each header is also written to its pfValid flag,
+ * if it has one, so that the caller can tell which headers of a batch have
+ * been verified.
+ * Headers added together with their block also get the rest of CheckBlock(),
+ * which marks the block as checked.
+ */
+class CHeaderPoWCheck
+{
+private:
+    std::vector<const CBlockHeader*> vpheaders;
+    std::vector<const CBlock*> vpblocks;
+    std::vector<char*> vpfValid;
+    const Consensus::Params *pconsensusParams;
+
+public:
+    CHeaderPoWCheck(): pconsensusParams(nullptr) {}
+    explicit CHeaderPoWCheck(const Consensus::Params& consensusParamsIn) : pconsensusParams(&consensusParamsIn) {}
+
+    void Add(const CBlockHeader& header, char* pfValid, const CBlock* pblock = nullptr) {
+        vpheaders.push_back(&header);
+        vpblocks.push_back(pblock);
+        vpfValid.push_back(pfValid);
+    }
+
+    size_t size() const { return vpheaders.size(); }
+
+    bool operator()() {
+        // Headers that cannot be looked up are hashed together, so that
+        // scrypt and NeoScrypt headers go through the multi-buffer kernels.
+        std::vector<char> vValid(vpheaders.size(), 0);
+        std::vector<const CBlockHeader*> vpheadersToHash;
+        std::vector<size_t> vToHash;
+        for (size_t i = 0; i < vpheaders.size(); i++) {
+            bool fValid;
+            if (LookupBlockProofOfWork(*vpheaders[i], vpheaders[i]->GetHash(), *pconsensusParams, fImporting, fValid)) {
+                vValid[i] = fValid;
+            } else {
+                vpheadersToHash.push_back(vpheaders[i]);
+                vToHash.push_back(i);
+            }
+        }
+        const std::vector<uint256> vHashPoW = GetPoWHashes(vpheadersToHash);
+        for (size_t i = 0; i < vpheadersToHash.size(); i++)
+            vValid[vToHash[i]] = CheckBlockProofOfWork(*vpheadersToHash[i], *pconsensusParams, false, &vHashPoW[i]);
+        // The proof of work is cached now, so CheckBlock() only adds the
+        // merkle root and transaction checks.
+        for (size_t i = 0; i < vpblocks.size(); i++) {
+            if (vpblocks[i] && vValid[i]) {
+                CValidationState state;
+                vValid[i] = CheckBlock(*vpblocks[i], state, *pconsensusParams);
+            }
+        }
+        bool fOk = true;
+        for (size_t i = 0; i < vpheaders.size(); i++) {
+            if (vpfValid[i])
+                *vpfValid[i] = vValid[i];
+            fOk = fOk && vValid[i];
+        }
+        return fOk;
+    }
+
+    void swap(CHeaderPoWCheck &check) {
+        vpheaders.swap(check.vpheaders);
+        vpblocks.swap(check.vpblocks);
+        vpfValid.swap(check.vpfValid);
+        std::swap(pconsensusParams, check.pconsensusParams);
+    }
+};
+
+static CCheckQueue<CHeaderPoWCheck> headerpowcheckqueue(4);
+
+//! Index of a header check group that has not been started yet, see AddHeaderPoWCheck()
+static const size_t NO_HEADER_POW_GROUP = std::numeric_limits<size_t>::max();
+
+/**
+ * Add the check of a header (and its block, if pblock is set) to vChecks.
+ * Scrypt and NeoScrypt headers are grouped to fill their multi-buffer kernels,
+ * the others are checked one by one. nScryptCheck and nNeoscryptCheck are the
+ * indexes of the groups being filled, and must start out at NO_HEADER_POW_GROUP.
+ * pfValid may be null if the caller does not need the outcome.
+ */
+static void AddHeaderPoWCheck(std::vector<CHeaderPoWCheck>& vChecks, size_t& nScryptCheck, size_t& nNeoscryptCheck,
+                              const CBlockHeader& header, char* pfValid, const CBlock* pblock, const Consensus::Params& consensusParams)
+{
+    size_t* pnGroup = header.IsScryptPoW() ? &nScryptCheck : header.IsNeoscryptPoW() ? &nNeoscryptCheck : nullptr;
+    const size_t nLanes = header.IsScryptPoW() ? scrypt_batch_lanes() : neoscrypt_batch_lanes();
+    if (pnGroup && *pnGroup < vChecks.size() && vChecks[*pnGroup].size() < nLanes) {
+        vChecks[*pnGroup].Add(header, pfValid, pblock);
+        return;
+    }
+    vChecks.emplace_back(consensusParams);
+    vChecks.back().Add(header, pfValid, pblock);
+    if (pnGroup)
+        *pnGroup = vChecks.size() - 1;
+}
+
+void ThreadHeaderPoWCheck() {
+    RenameThread("bitcoin-powchk");
+    // Each worker owns a yescrypt context for the lifetime of the thread, so
+    // its scratch memory is set up once instead of per header.
+    if (!yescrypt_thread_ctx())
+        LogPrintf("%s: failed to create yescrypt context\n", __func__);
+    headerpowcheckqueue.Thread();
+}
+
+/**
+ * Closure representing the database read of a run of coins spent by a block
+ * about to be connected. The coins are only read here, in one batch; the
+ * caller adds them to the cache after all reads have finished.
+ */
+class CCoinsPrefetch
+{
+private:
+    const CCoinsViewCache *pcoins;
+    std::vector<COutPoint> vOutPoints;
+    Coin *pcoin;
+    char *pfFound;
+
+public:
+    CCoinsPrefetch(): pcoins(nullptr), pcoin(nullptr), pfFound(nullptr) {}
+    CCoinsPrefetch(const CCoinsViewCache& coinsIn, std::vector<COutPoint>::const_iterator begin, std::vector<COutPoint>::const_iterator end, Coin* pcoinIn, char* pfFoundIn) :
+        pcoins(&coinsIn), vOutPoints(begin, end), pcoin(pcoinIn), pfFound(pfFoundIn) {}
+
+    bool operator()() {
+        std::vector<Coin> vCoins;
+        std::vector<bool> vFound;
+        pcoins->GetCoinsFromBase(vOutPoints, vCoins, vFound);
+        for (size_t i = 0; i < vOutPoints.size(); i++) {
+            if (vFound[i]) {
+                pcoin[i] = std::move(vCoins[i]);
+                pfFound[i] = 1;
+            }
+        }
+        return true;
+    }
+
+    void swap(CCoinsPrefetch &check) {
+        std::swap(pcoins, check.pcoins);
+        vOutPoints.swap(check.vOutPoints);
+        std::swap(pcoin, check.pcoin);
+        std::swap(pfFound, check.pfFound);
+    }
+};
+
+static CCheckQueue<CCoinsPrefetch> coinsprefetchqueue(16);
+
+void ThreadCoinsPrefetch() {
+    RenameThread("bitcoin-prefetch");
+    coinsprefetchqueue.Thread();
+}
+
+/**
+ * Warm the coins cache with the coins spent by a block before it is connected.
+ * The coins missing from the cache are read from the database on the coins
+ * prefetch threads, so that ConnectBlock does not wait for those reads one at
+ * a time. Nothing else may modify the coins while this runs (cs_main is held).
+ */
+static void PrefetchBlockCoins(const CBlock& block, CCoinsViewCache& coins)
+{
+    AssertLockHeld(cs_main);
+    if (!fPrefetchCoins || nScriptCheckThreads == 0)
+        return;
+
+    // Outputs created by the block itself are not in the database yet.
+    std::set<uint256> setBlockTxids;
+    for (const auto& tx : block.vtx)
+        setBlockTxids.insert(tx->GetHash());
+
+    std::vector<COutPoint> vOutPoints;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (!setBlockTxids.count(txin.prevout.hash) && !coins.HaveCoinInCache(txin.prevout))
+                vOutPoints.push_back(txin.prevout);
+        }
+    }
+    if (vOutPoints.empty())
+        return;
+
+    // Hand each thread runs of outpoints in key order, so that the database
+    // reads of one run hit neighbouring table blocks, while still making
+    // enough runs to keep all prefetch threads busy.
+    std::sort(vOutPoints.begin(), vOutPoints.end());
+    const size_t nRuns = nScriptCheckThreads * 4;
+    const size_t nRunSize = std::max<size_t>(8, (vOutPoints.size() + nRuns - 1) / nRuns);
+
+    std::vector<Coin> vCoins(vOutPoints.size());
+    std::vector<char> vFound(vOutPoints.size(), 0);
+    std::vector<CCoinsPrefetch> vChecks;
+    vChecks.reserve((vOutPoints.size() + nRunSize - 1) / nRunSize);
+    for (size_t i = 0; i < vOutPoints.size(); i += nRunSize) {
+        size_t nEnd = std::min(i + nRunSize, vOutPoints.size());
+        vChecks.emplace_back(coins, vOutPoints.begin() + i, vOutPoints.begin() + nEnd, &vCoins[i], &vFound[i]);
+    }
+    CCheckQueueControl<CCoinsPrefetch> control(&coinsprefetchqueue);
+    control.Add(vChecks);
+    control.Wait();
+
+    for (size_t i = 0; i < vOutPoints.size(); i++) {
+        if (vFound[i])
+            coins.AddFetchedCoin(vOutPoints[i], std::move(vCoins[i]));
+    }
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1861,6 +2261,35 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+/**
+ * Store the rolling UTXO set hash after a block, derived from the one after
+ * its parent and the coins the block creates and spends. The hashes are
+ * keyed by block hash, so disconnecting a block needs no update. Nothing is
+ * stored when the parent has no hash: the chain of hashes then restarts at
+ * the next full scan by gettxoutsetinfo.
+ */
+static bool UpdateTxOutSetHash(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    CTxOutSetHash hash;
+    if (!pcoinsdbview->ReadTxOutSetHash(pindex->pprev->GetBlockHash(), hash))
+        return true;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                hash.Remove(tx.vin[j].prevout, txundo.vprevout[j]);
+            }
+        }
+        // Unspendable outputs never enter the UTXO set (see AddCoin)
+        for (size_t j = 0; j < tx.vout.size(); j++) {
+            if (!tx.vout[j].scriptPubKey.IsUnspendable())
+                hash.Insert(COutPoint(tx.GetHash(), j), Coin(tx.vout[j], pindex->nHeight, i == 0));
+        }
+    }
+    return pcoinsdbview->WriteTxOutSetHash(pindex->GetBlockHash(), hash);
+}
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
@@ -1885,8 +2314,11 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block.GetHash() == chainparams.GetConsensus().hashGenesisBlock) {
-        if (!fJustCheck)
+        if (!fJustCheck) {
             view.SetBestBlock(pindex->GetBlockHash());
+            if (fTxOutSetHash && !pcoinsdbview->WriteTxOutSetHash(pindex->GetBlockHash(), CTxOutSetHash()))
+                return AbortNode(state, "Failed to write UTXO set hash");
+        }
         return true;
     }
 
@@ -1977,9 +2409,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     CAmount nFees = 0;
     int nInputs = 0;
     int64_t nSigOpsCost = 0;
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
-    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
-    vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
@@ -2036,9 +2465,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
             blockundo.vtxundo.push_back(CTxUndo());
         }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
-
-        vPos.push_back(std::make_pair(tx.GetHash(), pos));
-        pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime3 - nTime2), 0.001 * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * 0.000001);
@@ -2077,9 +2503,8 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return AbortNode(state, "Failed to write transaction index");
+    if (fTxOutSetHash && !UpdateTxOutSetHash(block, blockundo, pindex))
+        return AbortNode(state, "Failed to write UTXO set hash");
 
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
@@ -2127,6 +2552,8 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                 }
             }
         }
+        if (pcoinsdbview->BackgroundWriteFailed())
+            return AbortNode(state, "Failed to write to coin database");
         nNow = GetTimeMicros();
         // Avoid writing/flushing immediately after startup.
         if (nLastWrite == 0) {
@@ -2176,9 +2603,14 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                     return AbortNode(state, "Failed to write to block index database");
                 }
             }
-            // Finally remove any pruned files
-            if (fFlushForPrune)
+            // Finally remove any pruned files. A crash during the coin
+            // database write below is recovered by replaying the blocks since
+            // the last completed write, so that one must be done first.
+            if (fFlushForPrune) {
+                if (!pcoinsdbview->Sync())
+                    return AbortNode(state, "Failed to write to coin database");
                 UnlinkPrunedFiles(setFilesToPrune);
+            }
             nLastWrite = nNow;
         }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -2191,7 +2623,9 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // The coin database may write it in the background, except when
+            // the caller relies on everything being on disk.
+            if (!pcoinsTip->Flush() || (mode == FLUSH_STATE_ALWAYS && !pcoinsdbview->Sync()))
                 return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
         }
@@ -2340,6 +2774,7 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetchCoins = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2435,6 +2870,9 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    PrefetchBlockCoins(blockConnecting, *pcoinsTip);
+    int64_t nTimePrefetched = GetTimeMicros(); nTimePrefetchCoins += nTimePrefetched - nTime2;
+    LogPrint(BCLog::BENCH, "  - Prefetch coins: %.2fms [%.2fs]\n", (nTimePrefetched - nTime2) * 0.001, nTimePrefetchCoins * 0.000001);
     {
         CCoinsViewCache view(pcoinsTip);
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
@@ -2650,6 +3088,9 @@ static void NotifyHeaderTip() {
  * Make the best chain active, in multiple steps. The result is either failure
  * or an activated best chain. pblock is either nullptr or a pointer to a block
  * that is already loaded (to avoid loading it again from disk).
+ *
+ * Must be called without cs_main held, unless it connects no more than the
+ * genesis block, as it may wait for the validation interface queues.
  */
 bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock) {
     // Note that while we're often called here from ProcessNewBlock, this is
@@ -2665,6 +3106,11 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
         if (ShutdownRequested())
             break;
 
+        // Every step queues notifications that keep their blocks in memory
+        // until delivered, so let a subscriber that fell far behind catch up
+        // first. No callback runs on this thread, and no lock is held here.
+        GetMainSignals().LimitQueues(MAX_PENDING_CALLBACKS);
+
         const CBlockIndex *pindexFork;
         bool fInitialDownload;
         {
@@ -2792,6 +3238,7 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
     setDirtyBlockIndex.insert(pindex);
     setBlockIndexCandidates.erase(pindex);
     g_failed_blocks.insert(pindex);
+    ForgetPoWHash(pindex->GetBlockHash());
 
     // DisconnectTip will add transactions to disconnectpool; try to add these
     // back to the mempool.
@@ -2855,8 +3302,7 @@ static CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = NewBlockIndex(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3021,7 +3467,7 @@ static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos,
 static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
 {
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
+    if (fCheckPOW && !CheckBlockProofOfWork(block, consensusParams, fImporting))
         return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
 
     return true;
@@ -3277,7 +3723,7 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPOW = true)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -3296,7 +3742,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), fCheckPOW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3344,8 +3790,10 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             }
         }
     }
-    if (pindex == nullptr)
+    if (pindex == nullptr) {
         pindex = AddToBlockIndex(block);
+        RecordPoWHash(hash);
+    }
 
     if (ppindex)
         *ppindex = pindex;
@@ -3359,11 +3807,35 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    // Compute the proof of work of all unknown headers on the check queue
+    // before taking cs_main for the (serial) contextual checks. Headers whose
+    // check did not run or did not pass are simply checked again below, so
+    // error reporting is unchanged.
+    std::vector<char> vPoWValid(headers.size(), 0);
+    if (nScriptCheckThreads && headers.size() > 1) {
+        std::vector<CHeaderPoWCheck> vChecks;
+        vChecks.reserve(headers.size());
+        size_t nScryptCheck = NO_HEADER_POW_GROUP, nNeoscryptCheck = NO_HEADER_POW_GROUP;
+        {
+            LOCK(cs_main);
+            for (size_t i = 0; i < headers.size(); i++) {
+                if (mapBlockIndex.count(headers[i].GetHash()))
+                    continue;
+                AddHeaderPoWCheck(vChecks, nScryptCheck, nNeoscryptCheck, headers[i], &vPoWValid[i], nullptr, chainparams.GetConsensus());
+            }
+        }
+        CCheckQueueControl<CHeaderPoWCheck> control(&headerpowcheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!AcceptBlockHeader(header, state, chainparams, &pindex, !vPoWValid[i])) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -3568,6 +4040,7 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        UnmapDiskFiles(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -3709,6 +4182,96 @@ static FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly) {
     return OpenDiskFile(pos, "rev", fReadOnly);
 }
 
+namespace {
+
+/**
+ * Read-only mappings of block and undo files, most recently used first. A
+ * file that has grown past its mapping is mapped again; readers keep the
+ * mapping they got alive until they are done with it.
+ */
+class CDiskFileMappings
+{
+private:
+    struct Entry {
+        fs::path path;
+        int nFile;
+        std::shared_ptr<const fsbridge::MappedFile> mapping;
+    };
+
+    std::mutex cs;
+    std::list<Entry> listMappings;
+
+public:
+    /** Return a mapping of the file holding pos that is at least nMinSize bytes long, or nullptr. */
+    std::shared_ptr<const fsbridge::MappedFile> Get(const CDiskBlockPos& pos, const char* prefix, uint64_t nMinSize)
+    {
+        // Files are told apart by path, so a new data directory (as in the unit
+        // tests) never gets a stale mapping
+        const fs::path path = GetBlockPosFilename(pos, prefix);
+        std::lock_guard<std::mutex> lock(cs);
+        auto it = listMappings.begin();
+        while (it != listMappings.end() && it->path != path)
+            ++it;
+        if (it != listMappings.end()) {
+            if (it->mapping->size() >= nMinSize) {
+                listMappings.splice(listMappings.begin(), listMappings, it);
+                return it->mapping;
+            }
+            listMappings.erase(it);
+        }
+        std::shared_ptr<const fsbridge::MappedFile> mapping = fsbridge::mmap(path);
+        if (!mapping || mapping->size() < nMinSize)
+            return nullptr;
+        listMappings.push_front(Entry{path, pos.nFile, mapping});
+        while (listMappings.size() > (size_t)nBlockFileMaps)
+            listMappings.pop_back();
+        return mapping;
+    }
+
+    /** Drop the mappings of the block and undo files numbered nFile. */
+    void Erase(int nFile)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        listMappings.remove_if([nFile](const Entry& entry) { return entry.nFile == nFile; });
+    }
+};
+
+CDiskFileMappings diskFileMappings;
+
+} // namespace
+
+/**
+ * Find the record at pos in a mapping of its block or undo file: the nSize
+ * bytes that the file says start at pos, followed by nTrailer more bytes.
+ * Returns false if the file cannot be mapped or the record does not fit in
+ * it, in which case the caller should read it with stdio.
+ */
+static bool MapDiskRecord(const CDiskBlockPos& pos, const char* prefix, size_t nTrailer, std::shared_ptr<const fsbridge::MappedFile>& mapping, const char*& pbegin, const char*& pend)
+{
+    // Each record is preceded by the network magic and its size
+    if (nBlockFileMaps <= 0 || pos.IsNull() || pos.nPos < 8)
+        return false;
+    mapping = diskFileMappings.Get(pos, prefix, pos.nPos);
+    if (!mapping)
+        return false;
+    const unsigned int nSize = ReadLE32((const unsigned char*)mapping->data() + pos.nPos - 4);
+    const uint64_t nEnd = (uint64_t)pos.nPos + nSize + nTrailer;
+    if (nEnd > mapping->size()) {
+        // The file may have grown since it was mapped
+        mapping = diskFileMappings.Get(pos, prefix, nEnd);
+        if (!mapping)
+            return false;
+    }
+    pbegin = mapping->data() + pos.nPos;
+    pend = pbegin + nSize + nTrailer;
+    return true;
+}
+
+static void UnmapDiskFiles(int nFile)
+{
+    diskFileMappings.Erase(nFile);
+}
+
 fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix)
 {
     return GetDataDir() / "blocks" / strprintf("%s%05u.dat", prefix, pos.nFile);
@@ -3725,9 +4288,7 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw std::runtime_error(std::string(__func__) + ": new CBlockIndex failed");
+    CBlockIndex* pindexNew = NewBlockIndex(CBlockHeader());
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -3736,11 +4297,16 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
 
 bool static LoadBlockIndexDB(const CChainParams& chainparams)
 {
-    if (!pblocktree->LoadBlockIndexGuts(chainparams.GetConsensus(), InsertBlockIndex))
+    if (!pblocktree->LoadBlockIndexGuts(chainparams.GetConsensus(), InsertBlockIndex, ppowhashdb, nScriptCheckThreads))
         return false;
 
     boost::this_thread::interruption_point();
 
+    // The snapshot block has no transactions of its own on disk, and neither
+    // do its ancestors, so its nChainTx is stored separately.
+    uint64_t nSnapshotChainTx = 0;
+    pblocktree->ReadSnapshotBase(hashSnapshotBase, nSnapshotChainTx);
+
     // Calculate nChainWork
     std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
@@ -3768,6 +4334,8 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
             } else {
                 pindex->nChainTx = pindex->nTx;
             }
+        } else if (pindex->GetBlockHash() == hashSnapshotBase) {
+            pindex->nChainTx = nSnapshotChainTx;
         }
         if (!(pindex->nStatus & BLOCK_FAILED_MASK) && pindex->pprev && (pindex->pprev->nStatus & BLOCK_FAILED_MASK)) {
             pindex->nStatus |= BLOCK_FAILED_CHILD;
@@ -3828,10 +4396,6 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadReindexing(fReindexing);
     fReindex |= fReindexing;
 
-    // Check whether we have a transaction index
-    pblocktree->ReadFlag("txindex", fTxIndex);
-    LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
-
     return true;
 }
 
@@ -3864,6 +4428,104 @@ bool LoadChainTip(const CChainParams& chainparams)
     return true;
 }
 
+/** A block read by VerifyDB(), with the outcome of its context-free checks. */
+struct CVerifyBlock
+{
+    CBlockIndex* pindex;
+    CBlock block;
+    bool fRead;
+    bool fValid;
+    bool fUndoValid;
+    CValidationState state;
+
+    explicit CVerifyBlock(CBlockIndex* pindexIn) : pindex(pindexIn), fRead(false), fValid(false), fUndoValid(false) {}
+};
+
+/**
+ * Closure representing the disk reads and context-free checks of a block in
+ * VerifyDB(), which can run ahead of its serial disconnect and reconnect
+ * passes. cs_main is held by VerifyDB() throughout, so the block index does
+ * not change underneath.
+ */
+class CVerifyBlockCheck
+{
+private:
+    CVerifyBlock *pverify;
+    int nCheckLevel;
+    const Consensus::Params *pconsensusParams;
+
+public:
+    CVerifyBlockCheck(): pverify(nullptr), nCheckLevel(0), pconsensusParams(nullptr) {}
+    CVerifyBlockCheck(CVerifyBlock& verifyIn, int nCheckLevelIn, const Consensus::Params& consensusParamsIn) :
+        pverify(&verifyIn), nCheckLevel(nCheckLevelIn), pconsensusParams(&consensusParamsIn) {}
+
+    bool operator()() {
+        // check level 0: read from disk
+        pverify->fRead = ReadBlockFromDisk(pverify->block, pverify->pindex, *pconsensusParams);
+        if (!pverify->fRead)
+            return false;
+        // check level 1: verify block validity
+        pverify->fValid = nCheckLevel < 1 || CheckBlock(pverify->block, pverify->state, *pconsensusParams);
+        // check level 2: verify undo validity
+        pverify->fUndoValid = true;
+        CDiskBlockPos pos = pverify->pindex->GetUndoPos();
+        if (nCheckLevel >= 2 && !pos.IsNull()) {
+            CBlockUndo undo;
+            pverify->fUndoValid = UndoReadFromDisk(undo, pos, pverify->pindex->pprev->GetBlockHash());
+        }
+        return pverify->fValid && pverify->fUndoValid;
+    }
+
+    void swap(CVerifyBlockCheck &check) {
+        std::swap(pverify, check.pverify);
+        std::swap(nCheckLevel, check.nCheckLevel);
+        std::swap(pconsensusParams, check.pconsensusParams);
+    }
+};
+
+static CCheckQueue<CVerifyBlockCheck> verifyblockcheckqueue(1);
+
+void ThreadVerifyBlockCheck() {
+    RenameThread("bitcoin-verifyblk");
+    verifyblockcheckqueue.Thread();
+}
+
+/** Number of blocks VerifyDB() reads and checks ahead of the block it disconnects or reconnects. */
+static const size_t VERIFYDB_BATCH_SIZE = 16;
+
+/**
+ * Read and check the blocks of vpindex in batches on the verify block check
+ * threads, and pass them to fn in order. The next batch is checked while fn
+ * handles the current one. Stops early (returning false) if fn does.
+ */
+static bool ForEachVerifyBlock(const std::vector<CBlockIndex*>& vpindex, int nCheckLevel, const Consensus::Params& consensusParams, const std::function<bool(CVerifyBlock&)>& fn)
+{
+    std::deque<CVerifyBlock> vChecking, vDone;
+    std::unique_ptr<CCheckQueueControl<CVerifyBlockCheck> > control;
+    size_t nNext = 0;
+    while (nNext < vpindex.size() || !vChecking.empty()) {
+        if (control)
+            control->Wait();
+        control.reset();
+        vDone.swap(vChecking);
+        vChecking.clear();
+        if (nNext < vpindex.size()) {
+            std::vector<CVerifyBlockCheck> vChecks;
+            for (; nNext < vpindex.size() && vChecking.size() < VERIFYDB_BATCH_SIZE; nNext++) {
+                vChecking.emplace_back(vpindex[nNext]);
+                vChecks.emplace_back(vChecking.back(), nCheckLevel, consensusParams);
+            }
+            control.reset(new CCheckQueueControl<CVerifyBlockCheck>(&verifyblockcheckqueue));
+            control->Add(vChecks);
+        }
+        for (CVerifyBlock& verify : vDone) {
+            if (!fn(verify))
+                return false;
+        }
+    }
+    return true;
+}
+
 CVerifyDB::CVerifyDB()
 {
     uiInterface.ShowProgress(_("Verifying blocks..."), 0);
@@ -3885,16 +4547,32 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         nCheckDepth = chainActive.Height();
     nCheckLevel = std::max(0, std::min(4, nCheckLevel));
     LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
+    std::vector<CBlockIndex*> vpindex;
+    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev)
+    {
+        if (pindex->nHeight < chainActive.Height()-nCheckDepth)
+            break;
+        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            // If pruning, only go back as far as we have data.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+            break;
+        }
+        vpindex.push_back(pindex);
+    }
+
+    // The blocks are read and checked (levels 0 to 2) on the verify block
+    // check threads, ahead of the memory-only disconnect of level 3 here.
     CCoinsViewCache coins(coinsview);
     CBlockIndex* pindexState = chainActive.Tip();
     CBlockIndex* pindexFailure = nullptr;
     int nGoodTransactions = 0;
     CValidationState state;
     int reportDone = 0;
+    bool fResult = true;
     LogPrintf("[0%%]...");
-    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev)
-    {
+    ForEachVerifyBlock(vpindex, nCheckLevel, chainparams.GetConsensus(), [&](CVerifyBlock& verify) {
         boost::this_thread::interruption_point();
+        CBlockIndex* pindex = verify.pindex;
         int percentageDone = std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
         if (reportDone < percentageDone/10) {
             // report every 10% step
@@ -3902,64 +4580,58 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             reportDone = percentageDone/10;
         }
         uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone);
-        if (pindex->nHeight < chainActive.Height()-nCheckDepth)
-            break;
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
-            // If pruning, only go back as far as we have data.
-            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
-            break;
-        }
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus()))
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
-                         pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-            }
-        }
+        if (!verify.fRead)
+            return fResult = error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+        if (!verify.fValid)
+            return fResult = error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
+                                   pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(verify.state));
+        if (!verify.fUndoValid)
+            return fResult = error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
         if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
             assert(coins.GetBestBlock() == pindex->GetBlockHash());
-            DisconnectResult res = DisconnectBlock(block, pindex, coins);
+            DisconnectResult res = DisconnectBlock(verify.block, pindex, coins);
             if (res == DISCONNECT_FAILED) {
-                return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+                return fResult = error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
             }
             pindexState = pindex->pprev;
             if (res == DISCONNECT_UNCLEAN) {
                 nGoodTransactions = 0;
                 pindexFailure = pindex;
             } else {
-                nGoodTransactions += block.vtx.size();
+                nGoodTransactions += verify.block.vtx.size();
             }
         }
-        if (ShutdownRequested())
-            return true;
-    }
+        // Stop early, and report success
+        return !ShutdownRequested();
+    });
+    if (!fResult)
+        return false;
+    if (ShutdownRequested())
+        return true;
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
 
-    // check level 4: try reconnecting blocks
+    // check level 4: try reconnecting blocks, again with the reads ahead of
+    // the (serial) ConnectBlock calls
     if (nCheckLevel >= 4) {
-        CBlockIndex *pindex = pindexState;
-        while (pindex != chainActive.Tip()) {
-            boost::this_thread::interruption_point();
-            uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * 50))));
+        std::vector<CBlockIndex*> vpindexConnect;
+        for (CBlockIndex* pindex = pindexState; pindex != chainActive.Tip(); ) {
             pindex = chainActive.Next(pindex);
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-                return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-            if (!ConnectBlock(block, state, pindex, coins, chainparams))
-                return error("VerifyDB(): *** found unconnectable block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            vpindexConnect.push_back(pindex);
         }
+        ForEachVerifyBlock(vpindexConnect, 1, chainparams.GetConsensus(), [&](CVerifyBlock& verify) {
+            boost::this_thread::interruption_point();
+            CBlockIndex* pindex = verify.pindex;
+            uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * 50))));
+            if (!verify.fRead)
+                return fResult = error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            if (!ConnectBlock(verify.block, state, pindex, coins, chainparams))
+                return fResult = error("VerifyDB(): *** found unconnectable block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            return true;
+        });
+        if (!fResult)
+            return false;
     }
 
     LogPrintf("[DONE].\n");
@@ -4170,11 +4842,10 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    pblockindexpool.reset(new CBlockIndexPool());
     fHavePruned = false;
+    hashSnapshotBase.SetNull();
 }
 
 bool LoadBlockIndex(const CChainParams& chainparams)
@@ -4195,9 +4866,6 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         // needs_init.
 
         LogPrintf("Initializing databases...\n");
-        // Use the provided setting for -txindex in the new database
-        fTxIndex = gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX);
-        pblocktree->WriteFlag("txindex", fTxIndex);
     }
     return true;
 }
@@ -4233,6 +4901,248 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return true;
 }
 
+namespace {
+
+/** A block read from an external file, in the order of the file. */
+struct CExternalBlock
+{
+    std::shared_ptr<CBlock> pblock;
+    CDiskBlockPos pos;
+
+    CExternalBlock(std::shared_ptr<CBlock>&& pblockIn, const CDiskBlockPos& posIn) : pblock(std::move(pblockIn)), pos(posIn) {}
+};
+
+/** Serialized size of the blocks read from an external file before they are handed to the check queue. */
+const uint64_t EXTERNAL_BLOCK_BATCH_SIZE = 16 * 1000 * 1000;
+/** Number of batches the reader thread may get ahead of the one being checked. */
+const size_t EXTERNAL_BLOCK_READ_AHEAD = 2;
+
+/**
+ * Read blocks from blkdat into vBlocks until the batch is full. Returns false
+ * once the end of the file is reached. Runs on the CExternalBlockReader
+ * thread, which is not interruptible; shutdown waits for the current batch.
+ */
+bool ReadExternalBlocks(CBufferedFile& blkdat, uint64_t& nRewind, const CChainParams& chainparams, const CDiskBlockPos* dbp, std::vector<CExternalBlock>& vBlocks, uint64_t& nBytes)
+{
+    uint64_t nBatchBytes = 0;
+    while (!blkdat.eof() && nBatchBytes < EXTERNAL_BLOCK_BATCH_SIZE) {
+        blkdat.SetPos(nRewind);
+        nRewind++; // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        unsigned int nSize = 0;
+        try {
+            // locate a header
+            unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+            blkdat.FindByte(chainparams.MessageStart()[0]);
+            nRewind = blkdat.GetPos()+1;
+            blkdat >> FLATDATA(buf);
+            if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                continue;
+            // read size
+            blkdat >> nSize;
+            if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            return false;
+        }
+        try {
+            // read block
+            uint64_t nBlockPos = blkdat.GetPos();
+            blkdat.SetLimit(nBlockPos + nSize);
+            blkdat.SetPos(nBlockPos);
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            blkdat >> *pblock;
+            nRewind = blkdat.GetPos();
+            vBlocks.emplace_back(std::move(pblock), dbp ? CDiskBlockPos(dbp->nFile, nBlockPos) : CDiskBlockPos());
+            nBatchBytes += nSize;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+        }
+    }
+    nBytes += nBatchBytes;
+    return !blkdat.eof();
+}
+
+/**
+ * Reads batches of blocks from an external file on a thread of its own and
+ * hands them over in file order, so that reading overlaps with both checking
+ * and accepting. Stops reading ahead once EXTERNAL_BLOCK_READ_AHEAD batches
+ * are waiting. The file must outlive the reader.
+ */
+class CExternalBlockReader
+{
+private:
+    CBufferedFile& blkdat;
+    const CChainParams& chainparams;
+    const CDiskBlockPos* dbp;
+    //! Serialized size of all blocks read; only touched by the reader thread until it is joined
+    uint64_t& nBytes;
+
+    std::mutex cs;
+    std::condition_variable cond;
+    std::deque<std::vector<CExternalBlock>> queue;
+    bool fDone;
+    bool fStop;
+    std::string strError;
+    std::thread thread;
+
+    void Run()
+    {
+        RenameThread("bitcoin-loadblkrd");
+        try {
+            uint64_t nRewind = blkdat.GetPos();
+            bool fMore = true;
+            while (fMore) {
+                std::vector<CExternalBlock> vBlocks;
+                fMore = ReadExternalBlocks(blkdat, nRewind, chainparams, dbp, vBlocks, nBytes);
+                std::unique_lock<std::mutex> lock(cs);
+                cond.wait(lock, [this] { return fStop || queue.size() < EXTERNAL_BLOCK_READ_AHEAD; });
+                if (fStop)
+                    break;
+                queue.push_back(std::move(vBlocks));
+                cond.notify_all();
+            }
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(cs);
+            strError = e.what();
+        }
+        std::lock_guard<std::mutex> lock(cs);
+        fDone = true;
+        cond.notify_all();
+    }
+
+public:
+    CExternalBlockReader(CBufferedFile& blkdatIn, const CChainParams& chainparamsIn, const CDiskBlockPos* dbpIn, uint64_t& nBytesIn) :
+        blkdat(blkdatIn), chainparams(chainparamsIn), dbp(dbpIn), nBytes(nBytesIn), fDone(false), fStop(false)
+    {
+        thread = std::thread(&CExternalBlockReader::Run, this);
+    }
+
+    ~CExternalBlockReader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fStop = true;
+            cond.notify_all();
+        }
+        thread.join();
+    }
+
+    /**
+     * Wait for the next batch of blocks. Returns false once the whole file
+     * has been handed over, and throws if reading it failed.
+     */
+    bool Next(std::vector<CExternalBlock>& vBlocks)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        cond.wait(lock, [this] { return fDone || !queue.empty(); });
+        if (!queue.empty()) {
+            vBlocks = std::move(queue.front());
+            queue.pop_front();
+            cond.notify_all();
+            return true;
+        }
+        if (!strError.empty())
+            throw std::runtime_error(strError);
+        return false;
+    }
+};
+
+/**
+ * Queue the context-free checks of the blocks that are not known yet. Their
+ * results are cached in the proof of work cache and CBlock::fChecked, so the
+ * checks in AcceptBlock() become lookups.
+ */
+void QueueExternalBlockChecks(CCheckQueueControl<CHeaderPoWCheck>& control, std::vector<CExternalBlock>& vBlocks, const Consensus::Params& consensusParams)
+{
+    std::vector<CHeaderPoWCheck> vChecks;
+    vChecks.reserve(vBlocks.size());
+    size_t nScryptCheck = NO_HEADER_POW_GROUP, nNeoscryptCheck = NO_HEADER_POW_GROUP;
+    {
+        LOCK(cs_main);
+        for (CExternalBlock& block : vBlocks) {
+            BlockMap::const_iterator it = mapBlockIndex.find(block.pblock->GetHash());
+            if (it != mapBlockIndex.end() && (it->second->nStatus & BLOCK_HAVE_DATA))
+                continue;
+            AddHeaderPoWCheck(vChecks, nScryptCheck, nNeoscryptCheck, *block.pblock, nullptr, block.pblock.get(), consensusParams);
+        }
+    }
+    control.Add(vChecks);
+}
+
+/**
+ * Accept a block read from an external file, and the blocks found earlier
+ * in the file that build on it. Returns false if loading should stop.
+ */
+bool AcceptExternalBlock(const CChainParams& chainparams, const std::shared_ptr<CBlock>& pblock, CDiskBlockPos* dbp, std::multimap<uint256, CDiskBlockPos>& mapBlocksUnknownParent, int& nLoaded)
+{
+    const CBlock& block = *pblock;
+
+    // detect out of order blocks, and store them for later
+    uint256 hash = block.GetHash();
+    if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
+
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        LOCK(cs_main);
+        CValidationState state;
+        if (AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
+            {
+                LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
+                {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+
+} // namespace
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
@@ -4240,119 +5150,73 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
+    uint64_t nBytes = 0;
+    int64_t nTimeRead = 0, nTimeWait = 0, nTimeAccept = 0;
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
-
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
+        // Blocks are loaded in batches that move through three stages: while
+        // this thread accepts one batch (in file order, under cs_main), the
+        // check queue threads verify the next one, and the reader thread
+        // reads the ones after that.
+        CExternalBlockReader reader(blkdat, chainparams, dbp, nBytes);
+        std::vector<CExternalBlock> vChecking, vAccepting;
+        std::unique_ptr<CCheckQueueControl<CHeaderPoWCheck> > control;
+        bool fMore = true;
+        while (fMore || !vChecking.empty()) {
+            int64_t nTime1 = GetTimeMillis();
+            std::vector<CExternalBlock> vRead;
+            if (fMore)
+                fMore = reader.Next(vRead);
+            int64_t nTime2 = GetTimeMillis();
+            if (control)
+                control->Wait();
+            control.reset();
+            vAccepting.swap(vChecking);
+            vChecking.swap(vRead);
+            if (nScriptCheckThreads && !vChecking.empty()) {
+                control.reset(new CCheckQueueControl<CHeaderPoWCheck>(&headerpowcheckqueue));
+                QueueExternalBlockChecks(*control, vChecking, chainparams.GetConsensus());
             }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
-
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr))
-                        nLoaded++;
-                    if (state.IsError())
+            int64_t nTime3 = GetTimeMillis();
+            for (CExternalBlock& block : vAccepting) {
+                boost::this_thread::interruption_point();
+                try {
+                    if (!AcceptExternalBlock(chainparams, block.pblock, dbp ? &block.pos : nullptr, mapBlocksUnknownParent, nLoaded)) {
+                        // The check queue still refers to the blocks of the next batch
+                        fMore = false;
+                        if (control)
+                            control->Wait();
+                        control.reset();
+                        vChecking.clear();
                         break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
-
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
-
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
-                        {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
                     }
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
+            vAccepting.clear();
+            int64_t nTime4 = GetTimeMillis();
+            nTimeRead += nTime2 - nTime1;
+            nTimeWait += nTime3 - nTime2;
+            nTimeAccept += nTime4 - nTime3;
         }
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
-    if (nLoaded > 0)
-        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    if (nLoaded > 0) {
+        int64_t nTime = std::max<int64_t>(GetTimeMillis() - nStart, 1);
+        LogPrintf("Loaded %i blocks from external file in %dms (%.2f MB/s, %.1f blocks/s; read wait %dms, check wait %dms, accept %dms)\n",
+            nLoaded, nTime, nBytes * 0.001 / nTime, nLoaded * 1000.0 / nTime, nTimeRead, nTimeWait, nTimeAccept);
+    }
     return nLoaded > 0;
 }
 
 void static CheckBlockIndex(const Consensus::Params& consensusParams)
 {
-    if (!fCheckBlockIndex) {
+    // A chain state loaded from a UTXO set snapshot has a tip whose
+    // ancestors have no transactions, which the checks below do not allow.
+    if (!fCheckBlockIndex || !hashSnapshotBase.IsNull()) {
         return;
     }
 
@@ -4677,6 +5541,270 @@ void DumpMempool(void)
     }
 }
 
+static const uint64_t TXOUTSET_SNAPSHOT_VERSION = 1;
+
+/*
+ * A UTXO set snapshot holds, in order:
+ * - the snapshot version and the network magic;
+ * - the hash, height and nChainTx of the block it was taken at, and the
+ *   number of coins;
+ * - the headers of the blocks from height 1 up to that block;
+ * - the coins grouped by txid: the txid, the number of coins, and for each
+ *   coin its output index and the coin itself;
+ * - the hash of the block hash followed by every (outpoint, coin) pair.
+ */
+
+static void WriteTxOutSetCoins(CAutoFile& file, const uint256& hash, const std::vector<std::pair<uint32_t, Coin> >& coins)
+{
+    file << hash << VARINT((uint32_t)coins.size());
+    for (const auto& coin : coins) {
+        file << VARINT(coin.first) << coin.second;
+    }
+}
+
+bool DumpTxOutSet(const fs::path& path, CTxOutSetSnapshotInfo& info)
+{
+    int64_t nStart = GetTimeMillis();
+
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    std::vector<const CBlockIndex*> vChain;
+    {
+        // No other flush can start while cs_main is held, so the cursor sees
+        // the coins of the block it reports.
+        LOCK(cs_main);
+        FlushStateToDisk();
+        pcursor.reset(pcoinsdbview->Cursor());
+        BlockMap::const_iterator it = mapBlockIndex.find(pcursor->GetBestBlock());
+        if (it == mapBlockIndex.end())
+            return error("%s: unknown best block %s", __func__, pcursor->GetBestBlock().ToString());
+        const CBlockIndex* pindex = it->second;
+        info.hashBlock = pindex->GetBlockHash();
+        info.nHeight = pindex->nHeight;
+        info.nChainTx = pindex->nChainTx;
+        vChain.resize(pindex->nHeight);
+        for (; pindex->pprev; pindex = pindex->pprev) {
+            vChain[pindex->nHeight - 1] = pindex;
+        }
+    }
+
+    const fs::path pathTmp = path.string() + ".incomplete";
+    FILE* filestr = fsbridge::fopen(pathTmp, "wb");
+    if (!filestr)
+        return error("%s: unable to open %s", __func__, pathTmp.string());
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+
+    try {
+        file << TXOUTSET_SNAPSHOT_VERSION;
+        file << FLATDATA(Params().MessageStart());
+        file << info.hashBlock << info.nHeight << info.nChainTx;
+        // The number of coins is only known at the end.
+        const long nCoinsPos = ftell(file.Get());
+        info.nCoins = 0;
+        file << info.nCoins;
+        for (const CBlockIndex* pindex : vChain) {
+            file << pindex->GetBlockHeader();
+        }
+
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << info.hashBlock;
+        uint256 hashTx;
+        std::vector<std::pair<uint32_t, Coin> > coins;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+                return error("%s: unable to read value", __func__);
+            if (!coins.empty() && key.hash != hashTx) {
+                WriteTxOutSetCoins(file, hashTx, coins);
+                coins.clear();
+            }
+            hashTx = key.hash;
+            ss << key << coin;
+            coins.emplace_back(key.n, std::move(coin));
+            info.nCoins++;
+            pcursor->Next();
+        }
+        if (!coins.empty()) {
+            WriteTxOutSetCoins(file, hashTx, coins);
+        }
+        info.hashCoins = ss.GetHash();
+        file << info.hashCoins;
+
+        if (nCoinsPos < 0 || fseek(file.Get(), nCoinsPos, SEEK_SET) != 0)
+            return error("%s: unable to seek in %s", __func__, pathTmp.string());
+        file << info.nCoins;
+        FileCommit(file.Get());
+        file.fclose();
+    } catch (const std::exception& e) {
+        return error("%s: %s", __func__, e.what());
+    }
+    if (!RenameOver(pathTmp, path))
+        return error("%s: unable to rename %s", __func__, pathTmp.string());
+
+    LogPrintf("Dumped UTXO set snapshot: %u coins at block %s (height %d), %dms\n",
+        info.nCoins, info.hashBlock.ToString(), info.nHeight, GetTimeMillis() - nStart);
+    return true;
+}
+
+static bool ReadTxOutSetInfo(CAutoFile& file, const CChainParams& chainparams, CTxOutSetSnapshotInfo& info)
+{
+    uint64_t nVersion;
+    file >> nVersion;
+    if (nVersion != TXOUTSET_SNAPSHOT_VERSION)
+        return error("%s: unsupported snapshot version %u", __func__, nVersion);
+    CMessageHeader::MessageStartChars pchMessageStart;
+    file >> FLATDATA(pchMessageStart);
+    if (memcmp(pchMessageStart, chainparams.MessageStart(), sizeof(pchMessageStart)) != 0)
+        return error("%s: snapshot is for a different network", __func__);
+    file >> info.hashBlock >> info.nHeight >> info.nChainTx >> info.nCoins;
+    if (info.nHeight < 1 || info.nChainTx == 0)
+        return error("%s: invalid snapshot block", __func__);
+    return true;
+}
+
+/**
+ * Read the coins of a snapshot, pass each of them to fn, and check them
+ * against the hash that follows them. Stops early if fn returns false.
+ */
+static bool ReadTxOutSetCoins(CAutoFile& file, CTxOutSetSnapshotInfo& info, const std::function<bool(const COutPoint&, Coin&&)>& fn)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << info.hashBlock;
+    uint64_t nRead = 0;
+    while (nRead < info.nCoins) {
+        uint256 hashTx;
+        uint32_t nOutputs = 0;
+        file >> hashTx >> VARINT(nOutputs);
+        if (nOutputs == 0 || nOutputs > info.nCoins - nRead)
+            return error("%s: invalid number of coins for %s", __func__, hashTx.ToString());
+        for (uint32_t i = 0; i < nOutputs; i++) {
+            COutPoint outpoint(hashTx, 0);
+            Coin coin;
+            file >> VARINT(outpoint.n) >> coin;
+            ss << outpoint << coin;
+            if (!fn(outpoint, std::move(coin)))
+                return false;
+            if (++nRead % 1000000 == 0) {
+                LogPrintf("Read %u of %u coins from the UTXO set snapshot\n", nRead, info.nCoins);
+            }
+        }
+    }
+    file >> info.hashCoins;
+    if (info.hashCoins != ss.GetHash())
+        return error("%s: the coins do not match the snapshot hash", __func__);
+    return true;
+}
+
+bool LoadTxOutSet(const CChainParams& chainparams, const fs::path& path, const uint256& hashExpected)
+{
+    int64_t nStart = GetTimeMillis();
+    CTxOutSetSnapshotInfo info;
+    const unsigned int nHeaderSize = ::GetSerializeSize(CBlockHeader(), SER_DISK, CLIENT_VERSION);
+
+    // Check all coins against the hash first, so that a damaged or untrusted
+    // snapshot is rejected before the databases are touched.
+    LogPrintf("Checking UTXO set snapshot %s...\n", path.string());
+    try {
+        CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull())
+            return error("%s: unable to open %s", __func__, path.string());
+        if (!ReadTxOutSetInfo(file, chainparams, info))
+            return false;
+        if (fseek(file.Get(), (long)info.nHeight * nHeaderSize, SEEK_CUR) != 0)
+            return error("%s: unable to seek in %s", __func__, path.string());
+        if (!ReadTxOutSetCoins(file, info, [](const COutPoint&, Coin&&) { return !ShutdownRequested(); }))
+            return false;
+    } catch (const std::exception& e) {
+        return error("%s: %s", __func__, e.what());
+    }
+    // The hash in the file only detects damage; the chain state built from
+    // the snapshot is marked as validated, so it must be the expected one.
+    if (info.hashCoins != hashExpected)
+        return error("%s: snapshot hash %s does not match -assumeutxohash %s", __func__, info.hashCoins.ToString(), hashExpected.ToString());
+
+    // Until the load completes, the chain state is only partially written.
+    if (!pblocktree->WriteFlag("txoutsetload", true))
+        return error("%s: failed to write to the block index database", __func__);
+    {
+        LOCK(cs_main);
+        hashSnapshotBase = info.hashBlock;
+    }
+
+    try {
+        CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull())
+            return error("%s: unable to open %s", __func__, path.string());
+        if (!ReadTxOutSetInfo(file, chainparams, info))
+            return false;
+
+        // The headers are accepted like headers from the network, so their
+        // proof of work is checked.
+        std::vector<CBlockHeader> vHeaders;
+        vHeaders.reserve(MAX_HEADERS_RESULTS);
+        for (int nHeight = 1; nHeight <= info.nHeight; nHeight++) {
+            vHeaders.emplace_back();
+            file >> vHeaders.back();
+            if (vHeaders.size() == MAX_HEADERS_RESULTS || nHeight == info.nHeight) {
+                CValidationState state;
+                if (!ProcessNewBlockHeaders(vHeaders, state, chainparams))
+                    return error("%s: invalid header: %s", __func__, FormatStateMessage(state));
+                vHeaders.clear();
+                if (ShutdownRequested())
+                    return false;
+            }
+        }
+
+        CBlockIndex* pindexBase;
+        {
+            LOCK(cs_main);
+            BlockMap::iterator it = mapBlockIndex.find(info.hashBlock);
+            if (it == mapBlockIndex.end() || it->second->nHeight != info.nHeight)
+                return error("%s: the headers do not lead to block %s", __func__, info.hashBlock.ToString());
+            pindexBase = it->second;
+        }
+
+        bool fFlushOk = true;
+        CTxOutSetHash txoutsethash;
+        auto addcoin = [&](const COutPoint& outpoint, Coin&& coin) {
+            if (fTxOutSetHash && !coin.out.scriptPubKey.IsUnspendable())
+                txoutsethash.Insert(outpoint, coin);
+            pcoinsTip->AddCoin(outpoint, std::move(coin), false);
+            if (pcoinsTip->DynamicMemoryUsage() > nCoinCacheUsage) {
+                pcoinsTip->SetBestBlock(info.hashBlock);
+                fFlushOk = pcoinsTip->Flush();
+            }
+            return fFlushOk && !ShutdownRequested();
+        };
+        if (!ReadTxOutSetCoins(file, info, addcoin))
+            return fFlushOk ? false : error("%s: failed to write coins", __func__);
+
+        LOCK(cs_main);
+        pcoinsTip->SetBestBlock(info.hashBlock);
+        pindexBase->nChainTx = info.nChainTx;
+        pindexBase->RaiseValidity(BLOCK_VALID_SCRIPTS);
+        setDirtyBlockIndex.insert(pindexBase);
+        setBlockIndexCandidates.insert(pindexBase);
+        // The blocks before the snapshot are missing as if they were pruned.
+        fHavePruned = true;
+        if (!pblocktree->WriteSnapshotBase(info.hashBlock, info.nChainTx) || !pblocktree->WriteFlag("prunedblockfiles", true))
+            return error("%s: failed to write to the block index database", __func__);
+        if (fTxOutSetHash && !pcoinsdbview->WriteTxOutSetHash(info.hashBlock, txoutsethash))
+            return error("%s: failed to write the UTXO set hash", __func__);
+        CValidationState state;
+        if (!FlushStateToDisk(chainparams, state, FLUSH_STATE_ALWAYS))
+            return error("%s: %s", __func__, FormatStateMessage(state));
+    } catch (const std::exception& e) {
+        return error("%s: %s", __func__, e.what());
+    }
+    if (!pblocktree->WriteFlag("txoutsetload", false))
+        return error("%s: failed to write to the block index database", __func__);
+
+    LogPrintf("Loaded UTXO set snapshot: %u coins at block %s (height %d), %dms\n",
+        info.nCoins, info.hashBlock.ToString(), info.nHeight, GetTimeMillis() - nStart);
+    return true;
+}
+
 //! Guess how far we are in the verification process at the given block index
 double GuessVerificationProgress(const ChainTxData& data, CBlockIndex *pindex) {
     if (pindex == nullptr)
@@ -4700,10 +5828,7 @@ class CMainCleanup
 public:
     CMainCleanup() {}
     ~CMainCleanup() {
-        // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+        // block headers; the entries themselves are freed with pblockindexpool
         mapBlockIndex.clear();
     }
 } instance_of_cmaincleanup;
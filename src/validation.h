@@ -16,6 +16,7 @@
 #include "protocol.h" // For CMessageHeader::MessageStartChars
 #include "policy/feerate.h"
 #include "script/script_error.h"
+#include "support/allocators/pool.h"
 #include "sync.h"
 #include "versionbits.h"
 
@@ -31,7 +32,9 @@
 #include <atomic>
 
 class CBlockIndex;
+class CBlockUndo;
 class CBlockTreeDB;
+class CPoWHashDB;
 class CChainParams;
 class CCoinsViewDB;
 class CInv;
@@ -129,7 +132,22 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 /** Default for -permitbaremultisig */
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
+/** Default for -checkblockreadpow */
+static const bool DEFAULT_CHECK_BLOCK_READ_POW = false;
+/** Default for -powcachesize in MiB (about 130000 headers) */
+static const unsigned int DEFAULT_POW_CACHE_SIZE = 4;
+/** Maximum for -powcachesize in MiB */
+static const int64_t MAX_POW_CACHE_SIZE = 1024;
+/** Default for -blockfilemaps; mappings of 128 MB files only fit a 64-bit address space */
+static const unsigned int DEFAULT_BLOCK_FILE_MAPS = sizeof(void*) >= 8 ? 64 : 0;
+/** Default for -prefetchcoins */
+static const bool DEFAULT_PREFETCH_COINS = true;
 static const bool DEFAULT_TXINDEX = false;
+static const bool DEFAULT_ADDRESSINDEX = false;
+/** Default for -blockfilterindex */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+/** Default for -txoutsethash */
+static const bool DEFAULT_TXOUTSETHASH = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -145,6 +163,8 @@ static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
 static const int MAX_UNCONNECTING_HEADERS = 10;
 
 static const bool DEFAULT_PEERBLOOMFILTERS = true;
+/** Default for -peerblockfilters */
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
 
 /** Default for -stopatheight */
 static const int DEFAULT_STOPATHEIGHT = 0;
@@ -158,7 +178,12 @@ extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
 extern CBlockPolicyEstimator feeEstimator;
 extern CTxMemPool mempool;
-typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
+/**
+ * There is a mapBlockIndex node for every header the node has seen, so they
+ * come from a pool rather than from one malloc each.
+ */
+typedef PoolAllocator<std::pair<const uint256, CBlockIndex*>, sizeof(std::pair<const uint256, CBlockIndex*>) + 4 * sizeof(void*)> BlockMapAllocator;
+typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher, std::equal_to<uint256>, BlockMapAllocator> BlockMap;
 extern BlockMap mapBlockIndex;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockWeight;
@@ -168,11 +193,22 @@ extern CConditionVariable cvBlockChange;
 extern std::atomic_bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
-extern bool fTxIndex;
+/** Keep a rolling hash of the UTXO set after every block in the chain state database */
+extern bool fTxOutSetHash;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Recompute the proof of work of blocks read from disk through the block index */
+extern bool fCheckBlockReadPoW;
+/**
+ * Maximum number of block and undo files kept memory mapped for reading, 0 to
+ * read them with stdio. A disk read error on a mapped file raises SIGBUS and
+ * terminates the node, where stdio would fail just that read.
+ */
+extern int nBlockFileMaps;
+/** Read the coins spent by a block from the database on the script check threads before connecting it */
+extern bool fPrefetchCoins;
 extern size_t nCoinCacheUsage;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
@@ -270,11 +306,17 @@ bool LoadChainTip(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header proof of work checking thread */
+void ThreadHeaderPoWCheck();
+/** Run an instance of the coins prefetch thread */
+void ThreadCoinsPrefetch();
+/** Run an instance of the thread reading and checking blocks for VerifyDB */
+void ThreadVerifyBlockCheck();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256 &hash, CTransactionRef &tx, const Consensus::Params& params, uint256 &hashBlock, bool fAllowSlow = false);
-/** Find the best known block, and make it the tip of the block chain */
+/** Find the best known block, and make it the tip of the block chain. Call without cs_main held. */
 bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock = std::shared_ptr<const CBlock>());
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams);
 
@@ -392,10 +434,29 @@ public:
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
 
+/** Initializes the cache of headers that passed the proof of work check */
+void InitPoWCache();
+
+/**
+ * Check the proof of work of a header. The memory-hard PoW hash is only
+ * computed if the header is not in the proof of work cache, nor, if fReadDB,
+ * in ppowhashdb. Callers that already computed the PoW hash can pass it in
+ * phashPoW. The hash of a passing header is recorded in ppowhashdb once the
+ * header is added to mapBlockIndex, and dropped if its block turns out invalid.
+ */
+bool CheckBlockProofOfWork(const CBlockHeader& block, const Consensus::Params& consensusParams, bool fReadDB = false, const uint256* phashPoW = nullptr);
+
 
-/** Functions for disk access for blocks */
+/** Functions for disk access for blocks. Reading from a bare position always checks the
+ *  proof of work; reading through the block index trusts the already validated header
+ *  unless -checkblockreadpow is set. */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read the undo data of a block that has been connected */
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+/** Functions for disk access for undo data at a bare position, checksummed with the hash of the block's parent */
+bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -452,6 +513,9 @@ extern CCoinsViewCache *pcoinsTip;
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
+/** Global variable that points to the PoW hash database (thread-safe, may be nullptr) */
+extern CPoWHashDB *ppowhashdb;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
@@ -483,4 +547,29 @@ void DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Description of a UTXO set snapshot, see DumpTxOutSet(). */
+struct CTxOutSetSnapshotInfo
+{
+    //! The block the snapshot was taken at
+    uint256 hashBlock;
+    int nHeight;
+    uint64_t nChainTx;
+    uint64_t nCoins;
+    //! Hash of the block hash and all coins, checked before loading
+    uint256 hashCoins;
+
+    CTxOutSetSnapshotInfo() : nHeight(0), nChainTx(0), nCoins(0) {}
+};
+
+/** Write the UTXO set at the current tip to a snapshot file. */
+bool DumpTxOutSet(const fs::path& path, CTxOutSetSnapshotInfo& info);
+
+/**
+ * Load a snapshot written by DumpTxOutSet() into the empty chain state, so
+ * that the node continues from the snapshot block without connecting the
+ * blocks before it. Those blocks are treated as pruned. The snapshot is only
+ * loaded if its hash is hashExpected, which the user got from a trusted source.
+ */
+bool LoadTxOutSet(const CChainParams& chainparams, const fs::path& path, const uint256& hashExpected);
+
 #endif // BITCOIN_VALIDATION_H
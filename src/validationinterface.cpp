@@ -11,28 +11,76 @@
 #include "sync.h"
 #include "util.h"
 
+#include <chrono>
+#include <future>
 #include <list>
 #include <atomic>
 
-#include <boost/signals2/signal.hpp>
-
-struct MainSignalsInstance {
-    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
-    boost::signals2::signal<void (const CTransactionRef &)> TransactionAddedToMempool;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::vector<CTransactionRef>&)> BlockConnected;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &)> BlockDisconnected;
-    boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
-    boost::signals2::signal<void (const uint256 &)> Inventory;
-    boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
-    boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
-    boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
+/** A registered CValidationInterface with the queue of its background callbacks */
+struct ValidationInterfaceSubscriber {
+    CValidationInterface* pcallbacks;
+    std::string strName;
 
     // We are not allowed to assume the scheduler only runs in one thread,
-    // but must ensure all callbacks happen in-order, so we end up creating
-    // our own queue here :(
-    SingleThreadedSchedulerClient m_schedulerClient;
+    // but must ensure all callbacks to one subscriber happen in-order, so
+    // each subscriber gets its own queue
+    std::shared_ptr<SingleThreadedSchedulerClient> pqueue;
+
+    ValidationInterfaceSubscriber(CValidationInterface* pcallbacksIn, const std::string& strNameIn, CScheduler* pscheduler) :
+        pcallbacks(pcallbacksIn), strName(strNameIn), pqueue(std::make_shared<SingleThreadedSchedulerClient>(pscheduler)) {}
+};
+
+typedef std::shared_ptr<ValidationInterfaceSubscriber> ValidationInterfaceSubscriberRef;
 
-    MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler) {}
+struct MainSignalsInstance {
+    CScheduler *m_pscheduler;
+
+    CCriticalSection m_cs_subscribers;
+    std::vector<ValidationInterfaceSubscriberRef> m_subscribers;
+
+    MainSignalsInstance(CScheduler *pscheduler) : m_pscheduler(pscheduler) {}
+
+    std::vector<ValidationInterfaceSubscriberRef> GetSubscribers() {
+        LOCK(m_cs_subscribers);
+        return m_subscribers;
+    }
+
+    /** Call the synchronous callback f(subscriber) for every subscriber */
+    template <typename F>
+    void ForEach(F f) {
+        for (const ValidationInterfaceSubscriberRef& sub : GetSubscribers())
+            f(sub->pcallbacks);
+    }
+
+    /**
+     * Queue f(subscriber) for every subscriber. m_cs_subscribers is held
+     * while queueing, so that once UnregisterValidationInterface has removed
+     * a subscriber and cleared its queue nothing can be queued for it again.
+     */
+    template <typename F>
+    void Enqueue(F f) {
+        LOCK(m_cs_subscribers);
+        for (const ValidationInterfaceSubscriberRef& sub : m_subscribers) {
+            CValidationInterface* pcallbacks = sub->pcallbacks;
+            sub->pqueue->AddToProcessQueue([pcallbacks, f] { f(pcallbacks); });
+        }
+    }
+
+    /**
+     * Wait until the callbacks queued for sub so far have been delivered.
+     * Gives up when there is no scheduler thread left to deliver them, or
+     * when the subscriber is unregistered (which drops its queue).
+     */
+    void SyncWithQueue(const ValidationInterfaceSubscriberRef& sub) {
+        std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+        std::future<void> future = promise->get_future();
+        sub->pqueue->AddToProcessQueue([promise] { promise->set_value(); });
+        promise.reset();
+        while (future.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+            if (ShutdownRequested() || !m_pscheduler->AreThreadsServicingQueue())
+                return;
+        }
+    }
 };
 
 static CMainSignals g_signals;
@@ -47,7 +95,37 @@ void CMainSignals::UnregisterBackgroundSignalScheduler() {
 }
 
 void CMainSignals::FlushBackgroundCallbacks() {
-    m_internals->m_schedulerClient.EmptyQueue();
+    for (const ValidationInterfaceSubscriberRef& sub : m_internals->GetSubscribers())
+        sub->pqueue->EmptyQueue();
+}
+
+void CMainSignals::SyncWithQueues(const CValidationInterface* pcallbacks) {
+    if (!m_internals->m_pscheduler->AreThreadsServicingQueue())
+        return;
+    for (const ValidationInterfaceSubscriberRef& sub : m_internals->GetSubscribers()) {
+        if (!pcallbacks || sub->pcallbacks == pcallbacks)
+            m_internals->SyncWithQueue(sub);
+    }
+}
+
+void CMainSignals::LimitQueues(size_t nMaxPending) {
+    if (!m_internals->m_pscheduler->AreThreadsServicingQueue())
+        return;
+    for (const ValidationInterfaceSubscriberRef& sub : m_internals->GetSubscribers()) {
+        if (sub->pqueue->CallbacksPending() > nMaxPending) {
+            LogPrint(BCLog::BENCH, "%s: waiting for %s to catch up\n", __func__, sub->strName);
+            m_internals->SyncWithQueue(sub);
+        }
+    }
+}
+
+void CMainSignals::GetQueueStats(std::vector<CValidationInterfaceQueueStats>& vStats) {
+    vStats.clear();
+    for (const ValidationInterfaceSubscriberRef& sub : m_internals->GetSubscribers()) {
+        SingleThreadedSchedulerClient::Stats queueStats;
+        sub->pqueue->GetStats(queueStats);
+        vStats.push_back({sub->strName, queueStats.nPending, queueStats.nProcessed, queueStats.nLag, queueStats.nMaxLag});
+    }
 }
 
 CMainSignals& GetMainSignals()
@@ -55,74 +133,96 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.m_internals->UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
-    g_signals.m_internals->BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1));
-    g_signals.m_internals->SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.m_internals->Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.m_internals->Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.m_internals->BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.m_internals->NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& strName) {
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    LOCK(internals.m_cs_subscribers);
+    internals.m_subscribers.push_back(std::make_shared<ValidationInterfaceSubscriber>(pwalletIn, strName, internals.m_pscheduler));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.m_internals->BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.m_internals->Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.m_internals->Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.m_internals->SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.m_internals->TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
-    g_signals.m_internals->BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1));
-    g_signals.m_internals->UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    ValidationInterfaceSubscriberRef sub;
+    {
+        LOCK(internals.m_cs_subscribers);
+        for (auto it = internals.m_subscribers.begin(); it != internals.m_subscribers.end(); ++it) {
+            if ((*it)->pcallbacks == pwalletIn) {
+                sub = *it;
+                internals.m_subscribers.erase(it);
+                break;
+            }
+        }
+    }
+    if (!sub) return;
+    // Drop what has not been delivered yet, and let a callback that is
+    // running finish before the caller can destroy the subscriber.
+    sub->pqueue->ClearQueue();
+    if (internals.m_pscheduler->AreThreadsServicingQueue())
+        internals.SyncWithQueue(sub);
 }
 
 void UnregisterAllValidationInterfaces() {
-    g_signals.m_internals->BlockChecked.disconnect_all_slots();
-    g_signals.m_internals->Broadcast.disconnect_all_slots();
-    g_signals.m_internals->Inventory.disconnect_all_slots();
-    g_signals.m_internals->SetBestChain.disconnect_all_slots();
-    g_signals.m_internals->TransactionAddedToMempool.disconnect_all_slots();
-    g_signals.m_internals->BlockConnected.disconnect_all_slots();
-    g_signals.m_internals->BlockDisconnected.disconnect_all_slots();
-    g_signals.m_internals->UpdatedBlockTip.disconnect_all_slots();
-    g_signals.m_internals->NewPoWValidBlock.disconnect_all_slots();
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    std::vector<ValidationInterfaceSubscriberRef> subscribers;
+    {
+        LOCK(internals.m_cs_subscribers);
+        subscribers.swap(internals.m_subscribers);
+    }
+    for (const ValidationInterfaceSubscriberRef& sub : subscribers)
+        sub->pqueue->ClearQueue();
 }
 
 void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
-    m_internals->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+    m_internals->Enqueue([pindexNew, pindexFork, fInitialDownload](CValidationInterface* pcallbacks) {
+        pcallbacks->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+    });
 }
 
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef &ptx) {
-    m_internals->TransactionAddedToMempool(ptx);
+    m_internals->Enqueue([ptx](CValidationInterface* pcallbacks) {
+        pcallbacks->TransactionAddedToMempool(ptx);
+    });
 }
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) {
-    m_internals->BlockConnected(pblock, pindex, vtxConflicted);
+    // One copy of the conflicted transactions, shared by all the queues
+    std::shared_ptr<const std::vector<CTransactionRef>> pvtxConflicted = std::make_shared<const std::vector<CTransactionRef>>(vtxConflicted);
+    m_internals->Enqueue([pblock, pindex, pvtxConflicted](CValidationInterface* pcallbacks) {
+        pcallbacks->BlockConnected(pblock, pindex, *pvtxConflicted);
+    });
 }
 
 void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock) {
-    m_internals->BlockDisconnected(pblock);
+    m_internals->Enqueue([pblock](CValidationInterface* pcallbacks) {
+        pcallbacks->BlockDisconnected(pblock);
+    });
 }
 
 void CMainSignals::SetBestChain(const CBlockLocator &locator) {
-    m_internals->SetBestChain(locator);
+    m_internals->Enqueue([locator](CValidationInterface* pcallbacks) {
+        pcallbacks->SetBestChain(locator);
+    });
 }
 
 void CMainSignals::Inventory(const uint256 &hash) {
-    m_internals->Inventory(hash);
+    m_internals->ForEach([&hash](CValidationInterface* pcallbacks) {
+        pcallbacks->Inventory(hash);
+    });
 }
 
 void CMainSignals::Broadcast(int64_t nBestBlockTime, CConnman* connman) {
-    m_internals->Broadcast(nBestBlockTime, connman);
+    m_internals->ForEach([nBestBlockTime, connman](CValidationInterface* pcallbacks) {
+        pcallbacks->ResendWalletTransactions(nBestBlockTime, connman);
+    });
 }
 
 void CMainSignals::BlockChecked(const CBlock& block, const CValidationState& state) {
-    m_internals->BlockChecked(block, state);
+    m_internals->ForEach([&block, &state](CValidationInterface* pcallbacks) {
+        pcallbacks->BlockChecked(block, state);
+    });
 }
 
 void CMainSignals::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &block) {
-    m_internals->NewPoWValidBlock(pindex, block);
+    m_internals->ForEach([pindex, &block](CValidationInterface* pcallbacks) {
+        pcallbacks->NewPoWValidBlock(pindex, block);
+    });
 }
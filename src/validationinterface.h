@@ -7,6 +7,8 @@
 #define BITCOIN_VALIDATIONINTERFACE_H
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "primitives/transaction.h" // CTransaction(Ref)
 
@@ -21,10 +23,16 @@ class CValidationState;
 class uint256;
 class CScheduler;
 
+/**
+ * A subscriber with more callbacks than this queued holds up the processing
+ * of new blocks until it has caught up.
+ */
+static const size_t MAX_PENDING_CALLBACKS = 1000;
+
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/** Register a wallet to receive updates from core; strName identifies its queue in getnotificationqueueinfo */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& strName);
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
@@ -60,17 +68,40 @@ protected:
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend class CMainSignals;
+    friend void ::RegisterValidationInterface(CValidationInterface*, const std::string&);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
 };
 
+/** Queue statistics of one registered CValidationInterface */
+struct CValidationInterfaceQueueStats
+{
+    std::string strName;
+    //! Callbacks queued or running
+    size_t nPending;
+    //! Callbacks delivered since the subscriber was registered
+    uint64_t nDelivered;
+    //! Microseconds the oldest pending callback has been waiting
+    int64_t nLag;
+    //! Longest a callback has waited before being delivered, in microseconds
+    int64_t nMaxLag;
+};
+
 struct MainSignalsInstance;
+/**
+ * Delivers the validation interface callbacks. UpdatedBlockTip,
+ * TransactionAddedToMempool, BlockConnected, BlockDisconnected and
+ * SetBestChain are put on a queue per subscriber and delivered in order on
+ * the background scheduler, so the caller never waits for a subscriber and a
+ * slow subscriber does not hold up the others. The remaining callbacks are
+ * delivered synchronously.
+ */
 class CMainSignals {
 private:
     std::unique_ptr<MainSignalsInstance> m_internals;
 
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, const std::string&);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
 
@@ -81,6 +112,15 @@ public:
     void UnregisterBackgroundSignalScheduler();
     /** Call any remaining callbacks on the calling thread */
     void FlushBackgroundCallbacks();
+    /**
+     * Wait until all callbacks queued so far (to pcallbacks only, if given)
+     * have been delivered. Must not be called with locks held that a
+     * subscriber might take, such as cs_main.
+     */
+    void SyncWithQueues(const CValidationInterface* pcallbacks = nullptr);
+    /** Wait for the subscribers that have more than nMaxPending callbacks queued, with the same caveat as SyncWithQueues */
+    void LimitQueues(size_t nMaxPending);
+    void GetQueueStats(std::vector<CValidationInterfaceQueueStats>& vStats);
 
     void UpdatedBlockTip(const CBlockIndex *, const CBlockIndex *, bool fInitialDownload);
     void TransactionAddedToMempool(const CTransactionRef &);
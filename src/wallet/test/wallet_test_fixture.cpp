@@ -19,7 +19,7 @@ WalletTestingSetup::WalletTestingSetup(const std::string& chainName):
     std::unique_ptr<CWalletDBWrapper> dbw(new CWalletDBWrapper(&bitdb, "wallet_test.dat"));
     pwalletMain = new CWallet(std::move(dbw));
     pwalletMain->LoadWallet(fFirstRun);
-    RegisterValidationInterface(pwalletMain);
+    RegisterValidationInterface(pwalletMain, "wallet");
 
     RegisterWalletRPCCommands(tableRPC);
 }
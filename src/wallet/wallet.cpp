@@ -4048,7 +4048,7 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
 
     LogPrintf(" wallet      %15dms\n", GetTimeMillis() - nStart);
 
-    RegisterValidationInterface(walletInstance);
+    RegisterValidationInterface(walletInstance, "wallet " + walletInstance->GetName());
 
     // Try to top up keypool. No-op if the wallet is locked.
     walletInstance->TopUpKeyPool();
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Litebitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the address index and its RPCs.
+
+- Check history, unspent outputs and balances of addresses against the
+  UTXO set, also when paging through results with cursors.
+- Check that the index follows a reorg.
+- Turn on -addressindex on a node with an existing chain and check that it
+  catches up to the same results.
+"""
+
+from decimal import Decimal
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes_bi,
+    sync_blocks,
+    wait_until,
+)
+
+# Coins are sent to the P2SH address of OP_TRUE, so they can be spent
+# without a wallet.
+REDEEM_SCRIPT = "51"
+ADDRESS = "mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn"
+
+class AddressIndexTest(BitcoinTestFramework):
+
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-addressindex"], []]
+
+    def spend(self, node, height, amount):
+        """Send amount of the coinbase at height to ADDRESS, the change back."""
+        txid = node.getblock(node.getblockhash(height))["tx"][0]
+        value = node.gettxout(txid, 0)["value"]
+        outputs = {ADDRESS: amount, self.address: value - amount - Decimal("0.001")}
+        raw = node.createrawtransaction([{"txid": txid, "vout": 0}], outputs)
+        # Put the push of the redeem script in the empty scriptSig
+        offset = 2 * (4 + 1 + 36)
+        assert_equal(raw[offset:offset + 2], "00")
+        raw = raw[:offset] + "0201" + REDEEM_SCRIPT + raw[offset + 2:]
+        return node.sendrawtransaction(raw)
+
+    def paged(self, rpc, address, key, count):
+        """Collect all results of rpc, count at a time."""
+        result = rpc(address, count)
+        entries = result[key]
+        while result["next"] is not None:
+            assert_equal(len(result[key]), count)
+            result = rpc(address, count, result["next"])
+            entries += result[key]
+        return entries
+
+    def check_utxo_set(self, node):
+        """The two addresses own all coins, check the index agrees."""
+        total = Decimal(0)
+        for address in [self.address, ADDRESS]:
+            utxos = self.paged(node.getaddressutxos, address, "utxos", 7)
+            assert_equal(utxos, node.getaddressutxos(address)["utxos"])
+            for utxo in utxos:
+                assert_equal(node.gettxout(utxo["txid"], utxo["vout"], False)["value"], utxo["amount"])
+            balance = node.getaddressbalance(address)["balance"]
+            assert_equal(sum(utxo["amount"] for utxo in utxos), balance)
+            total += balance
+        assert_equal(total, node.gettxoutsetinfo()["total_amount"])
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        self.address = node0.decodescript(REDEEM_SCRIPT)["p2sh"]
+        node0.generatetoaddress(110, self.address)
+        assert_equal(len(node0.getaddresshistory(self.address)["history"]), 110)
+        assert_equal(node0.getaddressbalance(ADDRESS), {"balance": 0, "received": 0})
+        self.check_utxo_set(node0)
+
+        self.log.info("Spend coins to another address")
+        txid1 = self.spend(node0, 1, Decimal("1.5"))
+        txid2 = self.spend(node0, 2, Decimal("2.5"))
+        blockhash = node0.generatetoaddress(1, self.address)[0]
+        assert_equal(node0.getaddressbalance(ADDRESS), {"balance": Decimal("4"), "received": Decimal("4")})
+        history = node0.getaddresshistory(ADDRESS)["history"]
+        assert_equal(sorted(entry["txid"] for entry in history), sorted([txid1, txid2]))
+        for entry in history:
+            assert_equal(entry["height"], 111)
+            assert_equal(entry["spent"], False)
+            assert_equal(entry["index"], 0)
+        spends = [entry for entry in node0.getaddresshistory(self.address)["history"] if entry["spent"]]
+        assert_equal(sorted(entry["txid"] for entry in spends), sorted([txid1, txid2]))
+        self.check_utxo_set(node0)
+
+        self.log.info("Page through the history")
+        history = node0.getaddresshistory(self.address)["history"]
+        assert_equal(self.paged(node0.getaddresshistory, self.address, "history", 10), history)
+        assert_equal([entry["height"] for entry in history], sorted(entry["height"] for entry in history))
+        assert_raises_rpc_error(-8, "Invalid cursor", node0.getaddresshistory, self.address, 10, "00")
+        assert_raises_rpc_error(-8, "count must be positive", node0.getaddressutxos, self.address, 0)
+        assert_raises_rpc_error(-5, "Invalid address", node0.getaddressbalance, "foo")
+
+        self.log.info("Follow a reorg")
+        node0.invalidateblock(blockhash)
+        assert_equal(node0.getaddressbalance(ADDRESS), {"balance": 0, "received": 0})
+        assert_equal(node0.getaddresshistory(ADDRESS)["history"], [])
+        assert_equal(len(node0.getaddresshistory(self.address)["history"]), 110)
+        self.check_utxo_set(node0)
+        # Mine to the other address, so the block differs from the invalid one
+        coinbase = node0.getblock(node0.generatetoaddress(1, ADDRESS)[0])["tx"][0]
+        node0.generatetoaddress(1, self.address)
+        history = node0.getaddresshistory(ADDRESS)["history"]
+        assert_equal(sorted(entry["txid"] for entry in history), sorted([coinbase, txid1, txid2]))
+        self.check_utxo_set(node0)
+
+        self.log.info("Turn on the address index on a node with a chain")
+        connect_nodes_bi(self.nodes, 0, 1)
+        sync_blocks(self.nodes)
+        assert_raises_rpc_error(-1, "-addressindex", node1.getaddressbalance, ADDRESS)
+        self.stop_node(1)
+        self.start_node(1, ["-addressindex"])
+        wait_until(lambda: self.synced(node1), timeout=30)
+        for address in [self.address, ADDRESS]:
+            assert_equal(node1.getaddresshistory(address), node0.getaddresshistory(address))
+            assert_equal(node1.getaddressutxos(address), node0.getaddressutxos(address))
+            assert_equal(node1.getaddressbalance(address), node0.getaddressbalance(address))
+
+    def synced(self, node):
+        try:
+            node.getaddressbalance(ADDRESS)
+            return True
+        except Exception:
+            return False
+
+if __name__ == '__main__':
+    AddressIndexTest().main()
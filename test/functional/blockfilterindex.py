@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the compact block filter index and serving filters to peers.
+
+- Check that getblockfilter returns filters whose headers chain up.
+- Check the getcfilters, getcfheaders and getcfcheckpt p2p messages against
+  the rpc results, and that peers sending bad requests are disconnected.
+- Check that a node without -peerblockfilters does not serve filters.
+- Check that the index follows a reorg and keeps filters of stale blocks.
+- Turn on -blockfilterindex on a node with an existing chain and check that
+  it catches up to the same filter headers.
+"""
+
+from test_framework.mininode import (
+    NetworkThread,
+    NodeConn,
+    NodeConnCB,
+    NODE_COMPACT_FILTERS,
+    hash256,
+    mininode_lock,
+    msg_getcfcheckpt,
+    msg_getcfheaders,
+    msg_getcfilters,
+    ser_uint256,
+)
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes_bi,
+    p2p_port,
+    sync_blocks,
+)
+
+ADDRESS = "mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn"
+
+class FiltersClient(NodeConnCB):
+    def __init__(self):
+        super().__init__()
+        self.cfilters = []
+
+    def on_cfilter(self, conn, message):
+        self.cfilters.append(message)
+
+    def pop_cfilters(self):
+        cfilters = self.cfilters
+        self.cfilters = []
+        return cfilters
+
+class BlockFilterIndexTest(BitcoinTestFramework):
+
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-blockfilterindex", "-peerblockfilters"], []]
+
+    def filter_header(self, node, height):
+        return node.getblockfilter(node.getblockhash(height))["header"]
+
+    def connect(self, node_index):
+        client = FiltersClient()
+        conn = NodeConn('127.0.0.1', p2p_port(node_index), self.nodes[node_index], client)
+        client.add_connection(conn)
+        return client
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        node0.generatetoaddress(1010, ADDRESS)
+        sync_blocks(self.nodes)
+        tip_hash = node0.getbestblockhash()
+
+        self.log.info("Check that filter headers chain up")
+        prev_header = b"\x00" * 32
+        for height in range(0, 21):
+            result = node0.getblockfilter(node0.getblockhash(height))
+            filter_hash = hash256(bytes.fromhex(result["filter"]))
+            prev_header = hash256(filter_hash + prev_header)
+            assert_equal(result["header"], prev_header[::-1].hex())
+        assert_equal(node0.getblockfilter(node0.getblockhash(1), "basic"),
+                     node0.getblockfilter(node0.getblockhash(1)))
+        assert_raises_rpc_error(-5, "Unknown filtertype", node0.getblockfilter, tip_hash, "extended")
+        assert_raises_rpc_error(-5, "Block not found", node0.getblockfilter, "00" * 32)
+        assert_raises_rpc_error(-1, "Index is not enabled for filtertype basic", node1.getblockfilter, tip_hash)
+
+        self.log.info("Request filters from peers")
+        good = self.connect(0)
+        bad_range = self.connect(0)
+        bad_type = self.connect(0)
+        no_filters = self.connect(1)
+        NetworkThread().start()
+        for client in [good, bad_range, bad_type, no_filters]:
+            client.wait_for_verack()
+        assert good.connection.nServices & NODE_COMPACT_FILTERS
+        assert not no_filters.connection.nServices & NODE_COMPACT_FILTERS
+
+        tip = int(tip_hash, 16)
+        good.send_message(msg_getcfcheckpt(filter_type=0, stop_hash=tip))
+        good.sync_with_ping()
+        with mininode_lock:
+            checkpt = good.last_message["cfcheckpt"]
+        assert_equal(checkpt.stop_hash, tip)
+        assert_equal(["%064x" % header for header in checkpt.headers], [self.filter_header(node0, 1000)])
+
+        stop_hash = int(node0.getblockhash(1000), 16)
+        good.send_message(msg_getcfheaders(filter_type=0, start_height=1, stop_hash=stop_hash))
+        good.sync_with_ping()
+        with mininode_lock:
+            cfheaders = good.last_message["cfheaders"]
+        assert_equal(cfheaders.stop_hash, stop_hash)
+        assert_equal(len(cfheaders.hashes), 1000)
+        header = ser_uint256(cfheaders.prev_header)
+        assert_equal(header[::-1].hex(), self.filter_header(node0, 0))
+        for filter_hash in cfheaders.hashes:
+            header = hash256(ser_uint256(filter_hash) + header)
+        assert_equal(header[::-1].hex(), self.filter_header(node0, 1000))
+
+        stop_hash = int(node0.getblockhash(19), 16)
+        good.send_message(msg_getcfilters(filter_type=0, start_height=10, stop_hash=stop_hash))
+        good.sync_with_ping()
+        with mininode_lock:
+            cfilters = good.pop_cfilters()
+        assert_equal(len(cfilters), 10)
+        for height, cfilter in zip(range(10, 20), cfilters):
+            block_hash = node0.getblockhash(height)
+            assert_equal(cfilter.block_hash, int(block_hash, 16))
+            assert_equal(cfilter.filter_data.hex(), node0.getblockfilter(block_hash)["filter"])
+
+        self.log.info("Disconnect peers that send bad requests")
+        bad_range.send_message(msg_getcfilters(filter_type=0, start_height=0, stop_hash=tip))
+        bad_range.wait_for_disconnect()
+        bad_type.send_message(msg_getcfheaders(filter_type=1, start_height=0, stop_hash=stop_hash))
+        bad_type.wait_for_disconnect()
+        no_filters.send_message(msg_getcfheaders(filter_type=0, start_height=0, stop_hash=stop_hash))
+        no_filters.wait_for_disconnect()
+        good.sync_with_ping()
+
+        self.log.info("Follow a reorg")
+        stale_hash = node0.getbestblockhash()
+        stale_filter = node0.getblockfilter(stale_hash)
+        node0.invalidateblock(stale_hash)
+        # Mine to another address, or the first block comes out the same as the stale one
+        node0.generatetoaddress(2, node0.decodescript("51")["p2sh"])
+        assert_equal(node0.getblockfilter(stale_hash), stale_filter)
+        new_hash = node0.getblockhash(1010)
+        assert new_hash != stale_hash
+        new_filter = node0.getblockfilter(new_hash)
+        assert new_filter["filter"] != stale_filter["filter"]
+        filter_hash = hash256(bytes.fromhex(new_filter["filter"]))
+        prev_header = bytes.fromhex(self.filter_header(node0, 1009))[::-1]
+        assert_equal(new_filter["header"], hash256(filter_hash + prev_header)[::-1].hex())
+
+        self.log.info("Turn on the index on a node with an existing chain")
+        self.stop_node(1)
+        self.assert_start_raises_init_error(1, ["-peerblockfilters"], "Cannot set -peerblockfilters without -blockfilterindex.")
+        self.start_node(1, ["-blockfilterindex"])
+        connect_nodes_bi(self.nodes, 0, 1)
+        sync_blocks(self.nodes)
+        tip_hash = node0.getbestblockhash()
+        assert_equal(node1.getblockfilter(tip_hash), node0.getblockfilter(tip_hash))
+        assert_equal(self.filter_header(node1, 500), self.filter_header(node0, 500))
+
+if __name__ == '__main__':
+    BlockFilterIndexTest().main()
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the per-database LevelDB options and the getdbstats RPC.
+
+- Check that getdbstats lists the open databases with their settings.
+- Check that a setting for one database overrides the one for all of them.
+- Check that the statistics count block cache lookups.
+- Check that settings for unknown databases are rejected.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+ADDRESS = "mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn"
+
+class DBStatsTest(BitcoinTestFramework):
+
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [["-txindex", "-dbmaxopenfiles=100", "-dbmaxopenfiles=chainstate:200", "-dbbloombits=txindex:0", "-dbblockcache=blockindex:3"]]
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generatetoaddress(10, ADDRESS)
+
+        self.log.info("Check the settings of each database")
+        stats = {db["name"]: db for db in node.getdbstats()}
+        assert_equal(sorted(stats.keys()), ["blockindex", "chainstate", "powhash", "txindex"])
+        assert_equal(stats["chainstate"]["max_open_files"], 200)
+        assert_equal(stats["txindex"]["max_open_files"], 100)
+        assert_equal(stats["txindex"]["bloom_bits"], 0)
+        assert_equal(stats["chainstate"]["bloom_bits"], 10)
+        assert_equal(stats["blockindex"]["block_cache_size"], 3 << 20)
+        assert_equal(stats["chainstate"]["block_size"], 4096)
+        assert_equal(stats["chainstate"]["compression"], False)
+
+        self.log.info("Check that block cache lookups are counted")
+        txid = node.getblock(node.getblockhash(5))["tx"][0]
+        self.stop_node(0)
+        self.start_node(0, self.extra_args[0])
+        node.getrawtransaction(txid)
+        stats = {db["name"]: db for db in node.getdbstats()}
+        txindex = stats["txindex"]
+        assert txindex["block_cache_hits"] + txindex["block_cache_misses"] > 0
+        assert 0 <= txindex["block_cache_hit_rate"] <= 1
+        assert txindex["levels"]
+
+        self.log.info("Reject settings for unknown databases")
+        self.stop_node(0)
+        self.assert_start_raises_init_error(0, ["-dbmaxopenfiles=coins:100"], "Invalid value for -dbmaxopenfiles: 'coins:100'")
+        self.assert_start_raises_init_error(0, ["-dbblocksize=-4"], "Invalid value for -dbblocksize: '-4'")
+
+if __name__ == '__main__':
+    DBStatsTest().main()
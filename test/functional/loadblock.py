@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Litebitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test loading blocks from an external file with -loadblock.
+
+- Mine a chain on node0 and write its blocks to a file in the blk*.dat
+  format, with a corrupted copy of one block in the middle.
+- Start node1 with -loadblock and check that it skips the bad block and
+  still loads the whole chain.
+"""
+
+import os
+import struct
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, wait_until
+
+ADDRESS = "mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn"
+REGTEST_MAGIC = b"\xcc\xd6\xa0\xe3"
+
+class LoadBlockTest(BitcoinTestFramework):
+
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        node0.generatetoaddress(20, ADDRESS)
+
+        self.log.info("Write the chain to a file, with a bad block in the middle")
+        blocks = [bytes.fromhex(node0.getblock(node0.getblockhash(height), False)) for height in range(1, 21)]
+        # Changing the coinbase lock time keeps the header, so the bad block
+        # has the hash of the good one, but its merkle root no longer matches.
+        bad_block = blocks[10][:-1] + bytes([blocks[10][-1] ^ 1])
+        path = os.path.join(self.options.tmpdir, "bootstrap.dat")
+        with open(path, "wb") as f:
+            for block in blocks[:10] + [bad_block] + blocks[10:]:
+                f.write(REGTEST_MAGIC + struct.pack("<I", len(block)) + block)
+
+        self.log.info("Load the file on a node that has no blocks")
+        self.stop_node(1)
+        self.start_node(1, ["-loadblock=" + path])
+        wait_until(lambda: node1.getblockcount() == 20, timeout=60)
+        assert_equal(node1.getbestblockhash(), node0.getbestblockhash())
+        assert_equal(node1.getchaintips(), node0.getchaintips())
+
+if __name__ == '__main__':
+    LoadBlockTest().main()
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test getnotificationqueueinfo.
+
+- Check that the network code is listed as a subscriber.
+- Check that the notifications for new blocks get delivered, also with a
+  single scheduler thread.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, connect_nodes_bi, sync_blocks, wait_until
+
+ADDRESS = "mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn"
+
+class NotificationQueueTest(BitcoinTestFramework):
+
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [[], ["-schedulerthreads=1"]]
+
+    def get_queue(self, node, name):
+        queues = [queue for queue in node.getnotificationqueueinfo() if queue["name"] == name]
+        assert_equal(len(queues), 1)
+        return queues[0]
+
+    def run_test(self):
+        for node in self.nodes:
+            queue = self.get_queue(node, "net")
+            for key in ["pending", "delivered", "lag", "max_lag"]:
+                assert key in queue
+            assert queue["lag"] >= 0
+
+        self.log.info("Mine blocks and wait for their notifications")
+        delivered = [self.get_queue(node, "net")["delivered"] for node in self.nodes]
+        self.nodes[0].generatetoaddress(50, ADDRESS)
+        sync_blocks(self.nodes)
+        for i, node in enumerate(self.nodes):
+            wait_until(lambda: self.get_queue(node, "net")["pending"] == 0, timeout=30)
+            queue = self.get_queue(node, "net")
+            # At least a BlockConnected and an UpdatedBlockTip per block
+            assert queue["delivered"] >= delivered[i] + 100
+            assert_equal(queue["lag"], 0)
+
+        self.log.info("Restart a node and check it still relays new blocks")
+        self.stop_node(1)
+        self.start_node(1, ["-schedulerthreads=3"])
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.nodes[1].generatetoaddress(5, ADDRESS)
+        sync_blocks(self.nodes)
+        assert_equal(self.nodes[0].getblockcount(), 55)
+
+if __name__ == '__main__':
+    NotificationQueueTest().main()
@@ -53,6 +53,7 @@ NODE_GETUTXO = (1 << 1)
 NODE_BLOOM = (1 << 2)
 NODE_WITNESS = (1 << 3)
 NODE_UNSUPPORTED_SERVICE_BIT_5 = (1 << 5)
+NODE_COMPACT_FILTERS = (1 << 6)
 NODE_UNSUPPORTED_SERVICE_BIT_7 = (1 << 7)
 
 logger = logging.getLogger("TestFramework.mininode")
@@ -1454,6 +1455,150 @@ class msg_blocktxn(object):
     def __repr__(self):
         return "msg_blocktxn(block_transactions=%s)" % (repr(self.block_transactions))
 
+class msg_getcfilters(object):
+    command = b"getcfilters"
+
+    def __init__(self, filter_type=0, start_height=0, stop_hash=0):
+        self.filter_type = filter_type
+        self.start_height = start_height
+        self.stop_hash = stop_hash
+
+    def deserialize(self, f):
+        self.filter_type = struct.unpack("<B", f.read(1))[0]
+        self.start_height = struct.unpack("<I", f.read(4))[0]
+        self.stop_hash = deser_uint256(f)
+
+    def serialize(self):
+        r = b""
+        r += struct.pack("<B", self.filter_type)
+        r += struct.pack("<I", self.start_height)
+        r += ser_uint256(self.stop_hash)
+        return r
+
+    def __repr__(self):
+        return "msg_getcfilters(filter_type=%#x, start_height=%i, stop_hash=%x)" % (
+            self.filter_type, self.start_height, self.stop_hash)
+
+class msg_cfilter(object):
+    command = b"cfilter"
+
+    def __init__(self, filter_type=0, block_hash=0, filter_data=b""):
+        self.filter_type = filter_type
+        self.block_hash = block_hash
+        self.filter_data = filter_data
+
+    def deserialize(self, f):
+        self.filter_type = struct.unpack("<B", f.read(1))[0]
+        self.block_hash = deser_uint256(f)
+        self.filter_data = deser_string(f)
+
+    def serialize(self):
+        r = b""
+        r += struct.pack("<B", self.filter_type)
+        r += ser_uint256(self.block_hash)
+        r += ser_string(self.filter_data)
+        return r
+
+    def __repr__(self):
+        return "msg_cfilter(filter_type=%#x, block_hash=%x)" % (
+            self.filter_type, self.block_hash)
+
+class msg_getcfheaders(object):
+    command = b"getcfheaders"
+
+    def __init__(self, filter_type=0, start_height=0, stop_hash=0):
+        self.filter_type = filter_type
+        self.start_height = start_height
+        self.stop_hash = stop_hash
+
+    def deserialize(self, f):
+        self.filter_type = struct.unpack("<B", f.read(1))[0]
+        self.start_height = struct.unpack("<I", f.read(4))[0]
+        self.stop_hash = deser_uint256(f)
+
+    def serialize(self):
+        r = b""
+        r += struct.pack("<B", self.filter_type)
+        r += struct.pack("<I", self.start_height)
+        r += ser_uint256(self.stop_hash)
+        return r
+
+    def __repr__(self):
+        return "msg_getcfheaders(filter_type=%#x, start_height=%i, stop_hash=%x)" % (
+            self.filter_type, self.start_height, self.stop_hash)
+
+class msg_cfheaders(object):
+    command = b"cfheaders"
+
+    def __init__(self, filter_type=0, stop_hash=0, prev_header=0, hashes=None):
+        self.filter_type = filter_type
+        self.stop_hash = stop_hash
+        self.prev_header = prev_header
+        self.hashes = hashes if hashes is not None else []
+
+    def deserialize(self, f):
+        self.filter_type = struct.unpack("<B", f.read(1))[0]
+        self.stop_hash = deser_uint256(f)
+        self.prev_header = deser_uint256(f)
+        self.hashes = deser_uint256_vector(f)
+
+    def serialize(self):
+        r = b""
+        r += struct.pack("<B", self.filter_type)
+        r += ser_uint256(self.stop_hash)
+        r += ser_uint256(self.prev_header)
+        r += ser_uint256_vector(self.hashes)
+        return r
+
+    def __repr__(self):
+        return "msg_cfheaders(filter_type=%#x, stop_hash=%x)" % (
+            self.filter_type, self.stop_hash)
+
+class msg_getcfcheckpt(object):
+    command = b"getcfcheckpt"
+
+    def __init__(self, filter_type=0, stop_hash=0):
+        self.filter_type = filter_type
+        self.stop_hash = stop_hash
+
+    def deserialize(self, f):
+        self.filter_type = struct.unpack("<B", f.read(1))[0]
+        self.stop_hash = deser_uint256(f)
+
+    def serialize(self):
+        r = b""
+        r += struct.pack("<B", self.filter_type)
+        r += ser_uint256(self.stop_hash)
+        return r
+
+    def __repr__(self):
+        return "msg_getcfcheckpt(filter_type=%#x, stop_hash=%x)" % (
+            self.filter_type, self.stop_hash)
+
+class msg_cfcheckpt(object):
+    command = b"cfcheckpt"
+
+    def __init__(self, filter_type=0, stop_hash=0, headers=None):
+        self.filter_type = filter_type
+        self.stop_hash = stop_hash
+        self.headers = headers if headers is not None else []
+
+    def deserialize(self, f):
+        self.filter_type = struct.unpack("<B", f.read(1))[0]
+        self.stop_hash = deser_uint256(f)
+        self.headers = deser_uint256_vector(f)
+
+    def serialize(self):
+        r = b""
+        r += struct.pack("<B", self.filter_type)
+        r += ser_uint256(self.stop_hash)
+        r += ser_uint256_vector(self.headers)
+        return r
+
+    def __repr__(self):
+        return "msg_cfcheckpt(filter_type=%#x, stop_hash=%x)" % (
+            self.filter_type, self.stop_hash)
+
 class msg_witness_blocktxn(msg_blocktxn):
     def serialize(self):
         r = b""
@@ -1535,6 +1680,9 @@ class NodeConnCB(object):
     def on_alert(self, conn, message): pass
     def on_block(self, conn, message): pass
     def on_blocktxn(self, conn, message): pass
+    def on_cfcheckpt(self, conn, message): pass
+    def on_cfheaders(self, conn, message): pass
+    def on_cfilter(self, conn, message): pass
     def on_cmpctblock(self, conn, message): pass
     def on_feefilter(self, conn, message): pass
     def on_getaddr(self, conn, message): pass
@@ -1654,7 +1802,10 @@ class NodeConn(asyncore.dispatcher):
         b"sendcmpct": msg_sendcmpct,
         b"cmpctblock": msg_cmpctblock,
         b"getblocktxn": msg_getblocktxn,
-        b"blocktxn": msg_blocktxn
+        b"blocktxn": msg_blocktxn,
+        b"cfilter": msg_cfilter,
+        b"cfheaders": msg_cfheaders,
+        b"cfcheckpt": msg_cfcheckpt
     }
     MAGIC_BYTES = {
         "mainnet": b"\xfb\xc0\xb6\xdb",   # mainnet
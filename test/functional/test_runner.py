@@ -78,10 +78,18 @@ BASE_SCRIPTS= [
     'bip68-112-113-p2p.py',
     'rawtransactions.py',
     'reindex.py',
+    'loadblock.py',
+    'txoutsetsnapshot.py',
+    'txoutsethash.py',
     # vv Tests less than 30s vv
     'keypool-topup.py',
     'zmq_test.py',
     'bitcoin_cli.py',
+    'notificationqueue.py',
+    'txindex.py',
+    'addressindex.py',
+    'blockfilterindex.py',
+    'dbstats.py',
     'mempool_resurrect_test.py',
     'txn_doublespend.py --mineblock',
     'txn_clone.py',
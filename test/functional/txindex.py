@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the background transaction index.
+
+- Spend a coinbase, so that only the transaction index can still find it.
+- Turn on -txindex on a node with an existing chain, without -reindex, and
+  check that the index catches up and then follows new blocks.
+- Check that the index is kept across restarts and rebuilt with -reindex.
+"""
+
+from decimal import Decimal
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    wait_until,
+)
+
+# Coins are sent to the P2SH address of OP_TRUE, so they can be spent
+# without a wallet.
+REDEEM_SCRIPT = "51"
+ADDRESS = "mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn"
+
+class TxIndexTest(BitcoinTestFramework):
+
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def spend(self, node, txid):
+        """Spend the first output of txid to ADDRESS."""
+        value = node.gettxout(txid, 0)["value"]
+        raw = node.createrawtransaction([{"txid": txid, "vout": 0}], {ADDRESS: value - Decimal("0.001")})
+        # Put the push of the redeem script in the empty scriptSig
+        offset = 2 * (4 + 1 + 36)
+        assert_equal(raw[offset:offset + 2], "00")
+        raw = raw[:offset] + "0201" + REDEEM_SCRIPT + raw[offset + 2:]
+        return node.sendrawtransaction(raw)
+
+    def found(self, node, txid):
+        try:
+            return node.getrawtransaction(txid, True)["blockhash"]
+        except Exception:
+            return None
+
+    def run_test(self):
+        node = self.nodes[0]
+        address = node.decodescript(REDEEM_SCRIPT)["p2sh"]
+        node.generatetoaddress(110, address)
+        coinbase = node.getblock(node.getblockhash(1))["tx"][0]
+        spending = self.spend(node, coinbase)
+        node.generatetoaddress(1, address)
+        assert_raises_rpc_error(-5, "Use -txindex", node.getrawtransaction, coinbase)
+
+        self.log.info("Turn on the transaction index without a reindex")
+        self.stop_node(0)
+        self.start_node(0, ["-txindex"])
+        wait_until(lambda: self.found(node, coinbase) is not None, timeout=30)
+        assert_equal(self.found(node, coinbase), node.getblockhash(1))
+        assert_equal(self.found(node, spending), node.getblockhash(111))
+
+        self.log.info("Follow new blocks")
+        newer = node.getblock(node.getblockhash(2))["tx"][0]
+        spending = self.spend(node, newer)
+        blockhash = node.generatetoaddress(1, address)[0]
+        assert_equal(self.found(node, newer), node.getblockhash(2))
+        assert_equal(self.found(node, spending), blockhash)
+
+        self.log.info("Keep the index across restarts and rebuild it on -reindex")
+        for extra_args in [["-txindex"], ["-txindex", "-reindex"]]:
+            self.stop_node(0)
+            self.start_node(0, extra_args)
+            wait_until(lambda: node.getblockcount() == 112, timeout=30)
+            wait_until(lambda: self.found(node, coinbase) is not None, timeout=30)
+            assert_equal(self.found(node, spending), blockhash)
+
+        self.log.info("Turn the index off again")
+        self.stop_node(0)
+        self.start_node(0)
+        assert_raises_rpc_error(-5, "Use -txindex", node.getrawtransaction, coinbase)
+
+if __name__ == '__main__':
+    TxIndexTest().main()
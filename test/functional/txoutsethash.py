@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the rolling UTXO set hash kept with -txoutsethash.
+
+- Node 0 keeps the hash from genesis, node 1 only starts it later.
+- Check that the rolling totals match a full scan of the UTXO set, also after
+  blocks that spend coins.
+- Check that node 1 starts the hash from a scan of the tip and then agrees
+  with node 0.
+- Check the hashes at earlier heights, also after a reorg.
+"""
+
+from decimal import Decimal
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes_bi,
+    sync_blocks,
+)
+
+# Coins are sent to the P2SH address of OP_TRUE, so they can be spent
+# without a wallet.
+REDEEM_SCRIPT = "51"
+ADDRESS = "mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn"
+
+class TxOutSetHashTest(BitcoinTestFramework):
+
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-txoutsethash"], []]
+
+    def spend(self, node, height):
+        """Spend the coinbase of the block at height to two new outputs."""
+        txid = node.getblock(node.getblockhash(height))["tx"][0]
+        value = node.gettxout(txid, 0)["value"]
+        outputs = {self.address: value / 2, ADDRESS: value / 2 - Decimal("0.001")}
+        raw = node.createrawtransaction([{"txid": txid, "vout": 0}], outputs)
+        # Put the push of the redeem script in the empty scriptSig
+        offset = 2 * (4 + 1 + 36)
+        assert_equal(raw[offset:offset + 2], "00")
+        raw = raw[:offset] + "0201" + REDEEM_SCRIPT + raw[offset + 2:]
+        node.sendrawtransaction(raw)
+
+    def check_rolling(self, node):
+        full = node.gettxoutsetinfo()
+        rolling = node.gettxoutsetinfo("txoutset_hash")
+        for key in ["height", "bestblock", "txouts", "bogosize", "total_amount"]:
+            assert_equal(rolling[key], full[key])
+        return rolling
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        self.address = node0.decodescript(REDEEM_SCRIPT)["p2sh"]
+        node0.generatetoaddress(110, self.address)
+        sync_blocks(self.nodes)
+        self.check_rolling(node0)
+
+        self.log.info("Spend coins and compare with a full scan")
+        for height in range(1, 6):
+            self.spend(node0, height)
+        node0.generatetoaddress(1, self.address)
+        rolling = self.check_rolling(node0)
+        for height in range(6, 9):
+            self.spend(node0, height)
+        node0.generatetoaddress(1, self.address)
+        self.check_rolling(node0)
+        assert rolling["txoutset_hash"] != node0.gettxoutsetinfo("txoutset_hash")["txoutset_hash"]
+        assert_equal(node0.gettxoutsetinfo("txoutset_hash", 111)["txoutset_hash"], rolling["txoutset_hash"])
+        assert_raises_rpc_error(-8, "Block height out of range", node0.gettxoutsetinfo, "txoutset_hash", 113)
+        assert_raises_rpc_error(-8, "Unknown hash_type", node0.gettxoutsetinfo, "foo")
+        assert_raises_rpc_error(-8, "height is only supported", node0.gettxoutsetinfo, "hash_serialized_2", 1)
+
+        self.log.info("Start the rolling hash on a node that did not keep it")
+        sync_blocks(self.nodes)
+        assert_raises_rpc_error(-1, "-txoutsethash", node1.gettxoutsetinfo, "txoutset_hash")
+        self.stop_node(1)
+        self.start_node(1, ["-txoutsethash"])
+        assert_raises_rpc_error(-1, "No UTXO set hash", node1.gettxoutsetinfo, "txoutset_hash", 111)
+        assert_equal(node1.gettxoutsetinfo("txoutset_hash")["txoutset_hash"], node0.gettxoutsetinfo("txoutset_hash")["txoutset_hash"])
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.spend(node0, 9)
+        node0.generatetoaddress(1, self.address)
+        sync_blocks(self.nodes)
+        assert_equal(self.check_rolling(node1)["txoutset_hash"], self.check_rolling(node0)["txoutset_hash"])
+
+        self.log.info("Reorg to a different chain")
+        node0.invalidateblock(node0.getblockhash(112))
+        assert_equal(node0.gettxoutsetinfo("txoutset_hash")["txoutset_hash"], rolling["txoutset_hash"])
+        node0.generatetoaddress(3, self.address)
+        self.check_rolling(node0)
+        sync_blocks(self.nodes)
+        assert_equal(self.check_rolling(node1)["txoutset_hash"], self.check_rolling(node0)["txoutset_hash"])
+
+if __name__ == '__main__':
+    TxOutSetHashTest().main()
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Litebitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test dumptxoutset and starting a node with -loadtxoutset.
+
+- Generate blocks on node 0 and dump its UTXO set.
+- Check that -loadtxoutset requires -prune and the trusted snapshot hash, and
+  rejects a damaged snapshot or one with another hash.
+- Start node 1 from the snapshot and check it has the same UTXO set.
+- Connect the nodes and check that node 1 follows new blocks, also after a restart.
+"""
+
+import os
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes_bi,
+    sync_blocks,
+)
+
+ADDRESS = "mipcBbFg9gMiCh81Kj8tqqdgoZub1ZJRfn"
+
+class TxOutSetSnapshotTest(BitcoinTestFramework):
+
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def setup_network(self):
+        self.add_nodes(self.num_nodes)
+        self.start_node(0)
+
+    def run_test(self):
+        node0 = self.nodes[0]
+        node0.generatetoaddress(150, ADDRESS)
+
+        self.log.info("Dump the UTXO set")
+        result = node0.dumptxoutset("utxo.dat")
+        path = os.path.join(node0.datadir, "regtest", "utxo.dat")
+        assert_equal(result["path"], path)
+        assert_equal(result["base_height"], 150)
+        assert_equal(result["base_hash"], node0.getbestblockhash())
+        assert_equal(result["coins_written"], node0.gettxoutsetinfo()["txouts"])
+        assert_raises_rpc_error(-8, "already exists", node0.dumptxoutset, "utxo.dat")
+
+        self.log.info("Reject bad -loadtxoutset settings and snapshots")
+        snapshot_hash = result["txoutset_hash"]
+        load_args = ["-prune=1", "-loadtxoutset=" + path, "-assumeutxohash=" + snapshot_hash]
+        self.assert_start_raises_init_error(1, ["-loadtxoutset=" + path], "-loadtxoutset requires -prune")
+        self.assert_start_raises_init_error(1, ["-prune=1", "-loadtxoutset=" + path], "-loadtxoutset requires -assumeutxohash")
+        self.assert_start_raises_init_error(1, load_args[:2] + ["-assumeutxohash=xyz"], "Invalid hash for -assumeutxohash")
+        other_hash = "%064x" % (int(snapshot_hash, 16) ^ 1)
+        self.assert_start_raises_init_error(1, load_args[:2] + ["-assumeutxohash=" + other_hash], "Error loading UTXO set snapshot")
+        bad_path = os.path.join(self.options.tmpdir, "bad.dat")
+        with open(path, "rb") as f:
+            data = bytearray(f.read())
+        data[-40] ^= 1
+        with open(bad_path, "wb") as f:
+            f.write(data)
+        self.assert_start_raises_init_error(1, ["-prune=1", "-loadtxoutset=" + bad_path, "-assumeutxohash=" + snapshot_hash], "Error loading UTXO set snapshot")
+
+        self.log.info("Start a node from the snapshot")
+        self.start_node(1, load_args)
+        node1 = self.nodes[1]
+        assert_equal(node1.getbestblockhash(), node0.getbestblockhash())
+        assert_equal(node1.gettxoutsetinfo()["hash_serialized_2"], node0.gettxoutsetinfo()["hash_serialized_2"])
+        assert node1.getblockchaininfo()["pruned"]
+
+        self.log.info("Follow new blocks")
+        connect_nodes_bi(self.nodes, 0, 1)
+        node0.generatetoaddress(20, ADDRESS)
+        sync_blocks(self.nodes)
+        assert_equal(node1.gettxoutsetinfo()["hash_serialized_2"], node0.gettxoutsetinfo()["hash_serialized_2"])
+
+        self.log.info("Restart the node loaded from the snapshot")
+        self.stop_node(1)
+        self.start_node(1, load_args)
+        connect_nodes_bi(self.nodes, 0, 1)
+        node0.generatetoaddress(5, ADDRESS)
+        sync_blocks(self.nodes)
+        assert_equal(node1.getblockcount(), 175)
+        assert_equal(node1.gettxoutsetinfo()["hash_serialized_2"], node0.gettxoutsetinfo()["hash_serialized_2"])
+
+if __name__ == '__main__':
+    TxOutSetSnapshotTest().main()